@@ -0,0 +1,675 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include "assembler.h"
+#include "instruction.h"
+#include "machine_code.h"
+
+// perfect hash of the mnemonics: (first + 5 * second + last + 12 * length)
+// mod 64 is distinct for every one of them (second is 0 for "j")
+// slot -> Opcode + 1, 0 if no mnemonic hashes there
+#define MNEMONIC_SLOTS 64
+static const uint8_t mnemonic_slot[MNEMONIC_SLOTS] = {
+    [2] = OPC_LUI + 1,
+    [4] = OPC_MFHI + 1,
+    [6] = OPC_DADDIU + 1,
+    [10] = OPC_MFLO + 1,
+    [16] = OPC_SYSCALL + 1,
+    [17] = OPC_BNE + 1,
+    [20] = OPC_DSUBU + 1,
+    [23] = OPC_SB + 1,
+    [28] = OPC_LD + 1,
+    [29] = OPC_DSLL32 + 1,
+    [31] = OPC_JAL + 1,
+    [32] = OPC_J + 1,
+    [35] = OPC_SD + 1,
+    [39] = OPC_SLT + 1,
+    [46] = OPC_JR + 1,
+    [47] = OPC_LBU + 1,
+    [48] = OPC_BEQ + 1,
+    [49] = OPC_HALT + 1,
+    [52] = OPC_DSRA + 1,
+    [53] = OPC_DMULT + 1,
+    [54] = OPC_ORI + 1,
+    [58] = OPC_DADDU + 1,
+    [62] = OPC_DDIV + 1,
+    [63] = OPC_DSLL + 1,
+};
+
+// label: a slice of the source text (not terminated)
+typedef struct {
+    const char *name; // NULL: empty slot
+    int len;
+    bool code; // .code label (value: target id) or .data label (value: offset)
+    int64_t value;
+} AsmLabel;
+
+// pass 2 is split into chunks of this many instructions, each started at
+// the line of its first one (a line, its number, its pc)
+#define ASM_CHUNK_WORDS 16384
+
+typedef struct {
+    const char *text;
+    int line;
+    int64_t pc;
+} AsmChunk;
+
+typedef struct {
+    const char *name; // file name for messages
+    int line;
+    int errors;
+    AsmProgram *program;
+    uint64_t data_capacity;
+    // labels: open addressing, at most half full
+    AsmLabel *labels;
+    int label_size;
+    int label_count;
+    int symbol_capacity; // of program->symbols
+    // code label target id -> instruction index (what EncodeInstruction takes)
+    int64_t *targets;
+    int target_count;
+    int target_capacity;
+    // where pass 2 can start (set by pass 1)
+    AsmChunk *chunks;
+    int chunk_count;
+    int chunk_capacity;
+} Assembler;
+
+// rest of one line
+typedef struct {
+    const char *p;
+    const char *end;
+} Cursor;
+
+// one fprintf per message (pass 2 threads report at the same time)
+static void AsmError(Assembler *as, const char *format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    fprintf(stderr, "%s:%d: %s\n", as->name, as->line, message);
+    as->errors++;
+}
+
+static int MnemonicHash(const char *s, int len) {
+    return (s[0] + 5 * (len > 1 ? s[1] : 0) + s[len - 1] + 12 * len) & (MNEMONIC_SLOTS - 1);
+}
+
+// Opcode of a mnemonic, -1 if it is none
+static int LookupMnemonic(const char *s, int len) {
+    int op = mnemonic_slot[MnemonicHash(s, len)] - 1;
+    if(op < 0 || strncmp(instr_info[op].mnemonic, s, len) != 0 || instr_info[op].mnemonic[len] != '\0')
+        return -1;
+    return op;
+}
+
+// FNV-1a
+static uint32_t HashName(const char *s, int len) {
+    uint32_t h = 2166136261u;
+    for(int i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// slot holding the label, or the empty slot where it would go
+static AsmLabel* FindLabel(Assembler *as, const char *name, int len) {
+    uint32_t mask = as->label_size - 1;
+    for(uint32_t i = HashName(name, len) & mask; ; i = (i + 1) & mask) {
+        AsmLabel *label = &as->labels[i];
+        if(!label->name || (label->len == len && memcmp(label->name, name, len) == 0))
+            return label;
+    }
+}
+
+static void GrowLabels(Assembler *as) {
+    AsmLabel *old = as->labels;
+    int old_size = as->label_size;
+    as->label_size = old_size ? old_size * 2 : 256;
+    as->labels = calloc(as->label_size, sizeof(AsmLabel));
+    for(int i = 0; i < old_size; i++) {
+        if(old[i].name)
+            *FindLabel(as, old[i].name, old[i].len) = old[i];
+    }
+    free(old);
+}
+
+static void DefineLabel(Assembler *as, const char *name, int len, bool code, int64_t value) {
+    if(2 * (as->label_count + 1) > as->label_size)
+        GrowLabels(as);
+    AsmLabel *label = FindLabel(as, name, len);
+    if(label->name) {
+        AsmError(as, "label %.*s is defined twice", len, name);
+        return;
+    }
+    label->name = name;
+    label->len = len;
+    label->code = code;
+    label->value = value;
+    as->label_count++;
+
+    // and in definition order, for the symbol tables of the images
+    AsmProgram *program = as->program;
+    if(program->symbol_count >= as->symbol_capacity) {
+        as->symbol_capacity = as->symbol_capacity ? as->symbol_capacity * 2 : 64;
+        program->symbols = realloc(program->symbols, sizeof(AsmSymbol) * as->symbol_capacity);
+    }
+    AsmSymbol *symbol = &program->symbols[program->symbol_count++];
+    symbol->name = strndup(name, len);
+    symbol->code = code;
+    symbol->value = code ? as->targets[value] : value;
+}
+
+static int NewTarget(Assembler *as, int64_t index) {
+    if(as->target_count >= as->target_capacity) {
+        as->target_capacity = as->target_capacity ? as->target_capacity * 2 : 16;
+        as->targets = realloc(as->targets, sizeof(int64_t) * as->target_capacity);
+    }
+    as->targets[as->target_count] = index;
+    return as->target_count++;
+}
+
+static void AppendData(Assembler *as, const void *bytes, uint64_t n) {
+    AsmProgram *program = as->program;
+    if(n == 0)
+        return;
+    if(program->data_size + n > as->data_capacity) {
+        while(program->data_size + n > as->data_capacity)
+            as->data_capacity = as->data_capacity ? as->data_capacity * 2 : 256;
+        program->data = realloc(program->data, as->data_capacity);
+    }
+    if(bytes)
+        memcpy(program->data + program->data_size, bytes, n);
+    else
+        memset(program->data + program->data_size, 0, n);
+    program->data_size += n;
+}
+
+static void SkipSpace(Cursor *c) {
+    while(c->p < c->end && (*c->p == ' ' || *c->p == '\t'))
+        c->p++;
+}
+
+static bool AtEnd(Cursor *c) {
+    SkipSpace(c);
+    return c->p >= c->end || *c->p == ';';
+}
+
+static bool Accept(Cursor *c, char ch) {
+    SkipSpace(c);
+    if(c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+static bool IsNameStart(char ch) {
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+static bool IsNameChar(char ch) {
+    return IsNameStart(ch) || (ch >= '0' && ch <= '9');
+}
+
+// [A-Za-z_][A-Za-z0-9_]*
+static bool ParseName(Cursor *c, const char **name, int *len) {
+    SkipSpace(c);
+    if(c->p >= c->end || !IsNameStart(*c->p))
+        return false;
+    *name = c->p;
+    while(c->p < c->end && IsNameChar(*c->p))
+        c->p++;
+    *len = c->p - *name;
+    return true;
+}
+
+// [-]decimal or [-]0x hex (wraps like the 64-bit registers do)
+static bool ParseNumber(Cursor *c, int64_t *value) {
+    SkipSpace(c);
+    bool negative = c->p < c->end && *c->p == '-';
+    const char *start = c->p + negative;
+    const char *p = start;
+    uint64_t v = 0;
+    if(p + 1 < c->end && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        for(p += 2; p < c->end; p++) {
+            int digit;
+            if(*p >= '0' && *p <= '9') digit = *p - '0';
+            else if(*p >= 'a' && *p <= 'f') digit = *p - 'a' + 10;
+            else if(*p >= 'A' && *p <= 'F') digit = *p - 'A' + 10;
+            else break;
+            v = v * 16 + digit;
+        }
+        if(p == start + 2)
+            return false;
+    } else {
+        for(; p < c->end && *p >= '0' && *p <= '9'; p++)
+            v = v * 10 + (*p - '0');
+        if(p == start)
+            return false;
+    }
+    c->p = p;
+    *value = (int64_t)(negative ? 0 - v : v);
+    return true;
+}
+
+// rN, N in 0..31
+static bool ParseRegister(Assembler *as, Cursor *c, uint8_t *reg) {
+    SkipSpace(c);
+    int64_t n;
+    if(c->p >= c->end || *c->p != 'r') {
+        AsmError(as, "register expected");
+        return false;
+    }
+    c->p++;
+    if(!ParseNumber(c, &n) || n < 0 || n > 31) {
+        AsmError(as, "bad register");
+        return false;
+    }
+    *reg = n;
+    return true;
+}
+
+static bool ExpectComma(Assembler *as, Cursor *c) {
+    if(Accept(c, ','))
+        return true;
+    AsmError(as, "',' expected");
+    return false;
+}
+
+// #imm in [min, max]
+static bool ParseImmediate(Assembler *as, Cursor *c, int64_t min, int64_t max, int64_t *imm) {
+    if(!Accept(c, '#') || !ParseNumber(c, imm)) {
+        AsmError(as, "#immediate expected");
+        return false;
+    }
+    if(*imm < min || *imm > max) {
+        AsmError(as, "immediate %lld out of range", (long long)*imm);
+        return false;
+    }
+    return true;
+}
+
+static const AsmLabel* LookupLabel(Assembler *as, const char *name, int len, bool code) {
+    const AsmLabel *label = as->label_size ? FindLabel(as, name, len) : NULL;
+    if(!label || !label->name || label->code != code) {
+        AsmError(as, "%.*s is not a known %s label", len, name, code ? "code" : "data");
+        return NULL;
+    }
+    return label;
+}
+
+// .data label as a 16-bit offset from r0
+static bool ParseDataLabel(Assembler *as, Cursor *c, int64_t *offset) {
+    const char *name;
+    int len;
+    if(!ParseName(c, &name, &len)) {
+        AsmError(as, "label expected");
+        return false;
+    }
+    const AsmLabel *label = LookupLabel(as, name, len, false);
+    if(!label)
+        return false;
+    if(label->value > INT16_MAX) {
+        AsmError(as, "%.*s is out of 16-bit reach", len, name);
+        return false;
+    }
+    *offset = label->value;
+    return true;
+}
+
+static bool ParseCodeLabel(Assembler *as, Cursor *c, int64_t *target) {
+    const char *name;
+    int len;
+    if(!ParseName(c, &name, &len)) {
+        AsmError(as, "label expected");
+        return false;
+    }
+    const AsmLabel *label = LookupLabel(as, name, len, true);
+    if(!label)
+        return false;
+    *target = label->value;
+    return true;
+}
+
+// offset(rN), offset a number or a .data label
+static bool ParseMemory(Assembler *as, Cursor *c, Instruction *ins) {
+    SkipSpace(c);
+    if(c->p < c->end && IsNameStart(*c->p)) {
+        if(!ParseDataLabel(as, c, &ins->imm))
+            return false;
+    } else if(!ParseNumber(c, &ins->imm) || ins->imm < INT16_MIN || ins->imm > INT16_MAX) {
+        AsmError(as, "bad memory offset");
+        return false;
+    }
+    if(!Accept(c, '(') || !ParseRegister(as, c, &ins->rs) || !Accept(c, ')')) {
+        AsmError(as, "offset(register) expected");
+        return false;
+    }
+    return true;
+}
+
+// operands of ins->op, in the order PrintInstruction writes them
+static bool ParseOperands(Assembler *as, Cursor *c, Instruction *ins) {
+    switch(ins->op) {
+        case OPC_DADDIU:
+            if(!ParseRegister(as, c, &ins->rd) || !ExpectComma(as, c) || !ParseRegister(as, c, &ins->rs) || !ExpectComma(as, c))
+                return false;
+            SkipSpace(c);
+            if(c->p < c->end && *c->p == '#')
+                return ParseImmediate(as, c, INT16_MIN, INT16_MAX, &ins->imm);
+            return ParseDataLabel(as, c, &ins->imm);
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_SLT:
+            return ParseRegister(as, c, &ins->rd) && ExpectComma(as, c) && ParseRegister(as, c, &ins->rs) &&
+                   ExpectComma(as, c) && ParseRegister(as, c, &ins->rt);
+        case OPC_DMULT:
+        case OPC_DDIV:
+            return ParseRegister(as, c, &ins->rs) && ExpectComma(as, c) && ParseRegister(as, c, &ins->rt);
+        case OPC_MFLO:
+        case OPC_MFHI:
+            return ParseRegister(as, c, &ins->rd);
+        case OPC_LD:
+        case OPC_SD:
+        case OPC_LBU:
+        case OPC_SB:
+            return ParseRegister(as, c, &ins->rd) && ExpectComma(as, c) && ParseMemory(as, c, ins);
+        case OPC_DSLL:
+        case OPC_DSRA:
+        case OPC_DSLL32:
+            return ParseRegister(as, c, &ins->rd) && ExpectComma(as, c) && ParseRegister(as, c, &ins->rs) &&
+                   ExpectComma(as, c) && ParseImmediate(as, c, 0, 31, &ins->imm);
+        case OPC_ORI:
+            return ParseRegister(as, c, &ins->rd) && ExpectComma(as, c) && ParseRegister(as, c, &ins->rs) &&
+                   ExpectComma(as, c) && ParseImmediate(as, c, 0, 0xFFFF, &ins->imm);
+        case OPC_LUI:
+            return ParseRegister(as, c, &ins->rd) && ExpectComma(as, c) && ParseImmediate(as, c, 0, 0xFFFF, &ins->imm);
+        case OPC_BEQ:
+        case OPC_BNE:
+            return ParseRegister(as, c, &ins->rs) && ExpectComma(as, c) && ParseRegister(as, c, &ins->rt) &&
+                   ExpectComma(as, c) && ParseCodeLabel(as, c, &ins->imm);
+        case OPC_SYSCALL:
+            // the number sits in the 5-bit shamt field (plain syscall: 0)
+            if(AtEnd(c))
+                return true;
+            if(!ParseNumber(c, &ins->imm) || ins->imm < 0 || ins->imm > 31) {
+                AsmError(as, "bad syscall number");
+                return false;
+            }
+            return true;
+        case OPC_JAL:
+        case OPC_J:
+            return ParseCodeLabel(as, c, &ins->imm);
+        case OPC_JR:
+            return ParseRegister(as, c, &ins->rs);
+        case OPC_HALT:
+            return true;
+    }
+    return false;
+}
+
+// one .code line (label alr stripped) -> code[pc]
+static void AssembleInstruction(Assembler *as, Cursor *c, int64_t pc) {
+    const char *mnemonic = c->p;
+    while(c->p < c->end && ((*c->p >= 'a' && *c->p <= 'z') || (*c->p >= '0' && *c->p <= '9')))
+        c->p++;
+    int len = c->p - mnemonic;
+    int op = len > 0 ? LookupMnemonic(mnemonic, len) : -1;
+    if(op < 0 || op == OPC_LABEL) {
+        AsmError(as, "unknown instruction %.*s", len > 0 ? len : 1, mnemonic);
+        return;
+    }
+
+    Instruction ins = { .op = op, .sym = -1 };
+    if(!ParseOperands(as, c, &ins))
+        return;
+    if(!AtEnd(c)) {
+        AsmError(as, "junk after %s", instr_info[op].mnemonic);
+        return;
+    }
+    if(op == OPC_BEQ || op == OPC_BNE) {
+        int64_t offset = as->targets[ins.imm] - (pc + 1);
+        if(offset < INT16_MIN || offset > INT16_MAX) {
+            AsmError(as, "branch target out of reach");
+            return;
+        }
+    }
+    as->program->code[pc] = EncodeInstruction(&ins, as->targets, pc);
+}
+
+// "text" w/ \n \t \" \\ \0 escapes (the rest is taken as is)
+static bool ParseString(Assembler *as, Cursor *c, bool terminated) {
+    if(!Accept(c, '"')) {
+        AsmError(as, "string expected");
+        return false;
+    }
+    const char *p = c->p;
+    while(p < c->end && *p != '"') {
+        const char *run = p;
+        while(p < c->end && *p != '"' && *p != '\\')
+            p++;
+        AppendData(as, run, p - run);
+        if(p < c->end && *p == '\\' && p + 1 < c->end) {
+            char ch = p[1];
+            ch = ch == 'n' ? '\n' : ch == 't' ? '\t' : ch == '0' ? '\0' : ch;
+            AppendData(as, &ch, 1);
+            p += 2;
+        } else if(p < c->end && *p == '\\') {
+            p++;
+        }
+    }
+    if(p >= c->end) {
+        AsmError(as, "unterminated string");
+        return false;
+    }
+    c->p = p + 1;
+    if(terminated)
+        AppendData(as, "", 1);
+    return true;
+}
+
+// .space n | .ascii "s" | .asciiz "s" | .dword v, ...
+static void AssembleDirective(Assembler *as, Cursor *c) {
+    const char *name;
+    int len;
+    c->p++; // '.'
+    if(!ParseName(c, &name, &len)) {
+        AsmError(as, "directive expected");
+        return;
+    }
+    bool ok = true;
+    if(len == 5 && memcmp(name, "space", 5) == 0) {
+        int64_t n;
+        ok = ParseNumber(c, &n) && n >= 0;
+        if(ok)
+            AppendData(as, NULL, n);
+    } else if((len == 6 && memcmp(name, "asciiz", 6) == 0) || (len == 5 && memcmp(name, "ascii", 5) == 0)) {
+        if(!ParseString(as, c, len == 6))
+            return; // alr reported
+    } else if(len == 5 && memcmp(name, "dword", 5) == 0) {
+        do {
+            int64_t v;
+            ok = ParseNumber(c, &v);
+            uint8_t bytes[8];
+            for(int i = 0; i < 8; i++)
+                bytes[i] = (uint64_t)v >> (56 - 8 * i);
+            if(ok)
+                AppendData(as, bytes, 8);
+        } while(ok && Accept(c, ','));
+    } else {
+        AsmError(as, "unknown directive .%.*s", len, name);
+        return;
+    }
+    if(!ok)
+        AsmError(as, "bad operand for .%.*s", len, name);
+    else if(!AtEnd(c))
+        AsmError(as, "junk after .%.*s", len, name);
+}
+
+// record a place pass 2 can start encoding at
+static void NewChunk(Assembler *as, const char *text, int line, int64_t pc) {
+    if(as->chunk_count >= as->chunk_capacity) {
+        as->chunk_capacity = as->chunk_capacity ? as->chunk_capacity * 2 : 16;
+        as->chunks = realloc(as->chunks, sizeof(AsmChunk) * as->chunk_capacity);
+    }
+    AsmChunk chunk = { .text = text, .line = line, .pc = pc };
+    as->chunks[as->chunk_count++] = chunk;
+}
+
+// lines from text on (in .code or not), the first instruction being pc,
+// up to end or the line that holds instruction stop_pc; returns the pc
+// after the last instruction seen
+// pass 1 (encode false): .data image, label table, instruction count, chunks
+// pass 2 (encode true): the .code words
+static int64_t AssembleLines(Assembler *as, const char *text, const char *end, bool in_code,
+                             int64_t pc, int64_t stop_pc, bool encode) {
+    for(const char *line = text; line < end; ) {
+        const char *start = line;
+        const char *eol = memchr(line, '\n', end - line);
+        if(!eol)
+            eol = end;
+        as->line++;
+        Cursor c = { line, eol };
+        if(c.end > c.p && c.end[-1] == '\r')
+            c.end--;
+        line = eol + 1;
+
+        if(AtEnd(&c) || *c.p == '#')
+            continue; // blank or comment
+
+        // section directives
+        if(*c.p == '.') {
+            if(c.end - c.p >= 5 && (memcmp(c.p, ".data", 5) == 0 || memcmp(c.p, ".code", 5) == 0 ||
+                                    memcmp(c.p, ".text", 5) == 0) && (c.end - c.p == 5 || !IsNameChar(c.p[5]))) {
+                in_code = c.p[1] != 'd';
+                continue;
+            }
+        }
+
+        // label:
+        const char *name;
+        int name_len;
+        Cursor after = c;
+        if(ParseName(&after, &name, &name_len) && Accept(&after, ':')) {
+            if(!encode) {
+                if(in_code)
+                    DefineLabel(as, name, name_len, true, NewTarget(as, pc));
+                else
+                    DefineLabel(as, name, name_len, false, as->program->data_size);
+            }
+            c = after;
+            if(AtEnd(&c))
+                continue;
+        }
+
+        if(!in_code) {
+            if(*c.p != '.')
+                AsmError(as, "directive expected in .data");
+            else if(!encode)
+                AssembleDirective(as, &c);
+        } else {
+            if(pc == stop_pc)
+                break;
+            if(encode)
+                AssembleInstruction(as, &c, pc);
+            else if(pc % ASM_CHUNK_WORDS == 0)
+                NewChunk(as, start, as->line, pc);
+            pc++;
+        }
+    }
+    return pc;
+}
+
+// pass 2 work: the chunks, claimed one at a time
+typedef struct {
+    const Assembler *as; // read-only by now (labels, targets, chunks)
+    const char *end;
+    int next_chunk;
+    int errors;
+    pthread_mutex_t lock;
+} AsmWork;
+
+// each chunk encodes into its own part of program->code
+static void* AsmWorker(void *arg) {
+    AsmWork *work = arg;
+    Assembler as = *work->as; // own line number and error count
+    as.errors = 0;
+    for(;;) {
+        pthread_mutex_lock(&work->lock);
+        int k = work->next_chunk++;
+        pthread_mutex_unlock(&work->lock);
+        if(k >= as.chunk_count)
+            break;
+        const AsmChunk *chunk = &as.chunks[k];
+        int64_t stop_pc = k + 1 < as.chunk_count ? as.chunks[k + 1].pc : INT64_MAX;
+        as.line = chunk->line - 1;
+        AssembleLines(&as, chunk->text, work->end, true, chunk->pc, stop_pc, true);
+    }
+    pthread_mutex_lock(&work->lock);
+    work->errors += as.errors;
+    pthread_mutex_unlock(&work->lock);
+    return NULL;
+}
+
+bool AssembleText(const char *text, size_t len, const char *name, int jobs, AsmProgram *program) {
+    memset(program, 0, sizeof(*program));
+    Assembler as = { .name = name, .program = program };
+    program->code_count = AssembleLines(&as, text, text + len, false, 0, INT64_MAX, false);
+    if(as.errors == 0) {
+        program->code = calloc(program->code_count + 1, sizeof(uint32_t));
+        AsmWork work = { .as = &as, .end = text + len, .next_chunk = 0, .errors = 0 };
+        pthread_mutex_init(&work.lock, NULL);
+        // this thread works too
+        int threads = jobs < as.chunk_count ? jobs : as.chunk_count;
+        pthread_t *workers = malloc(sizeof(pthread_t) * (threads > 1 ? threads : 1));
+        int started = 0;
+        for(int t = 1; t < threads; t++) {
+            if(pthread_create(&workers[started], NULL, AsmWorker, &work) == 0)
+                started++;
+        }
+        AsmWorker(&work);
+        for(int t = 0; t < started; t++)
+            pthread_join(workers[t], NULL);
+        free(workers);
+        pthread_mutex_destroy(&work.lock);
+        as.errors += work.errors;
+    }
+    free(as.labels);
+    free(as.targets);
+    free(as.chunks);
+    return as.errors == 0;
+}
+
+bool AssembleFile(const char *filename, int jobs, AsmProgram *program) {
+    memset(program, 0, sizeof(*program));
+    FILE *in = fopen(filename, "rb");
+    if(!in) {
+        fprintf(stderr, "Error: Cannot open assembly file %s\n", filename);
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    rewind(in);
+    char *text = malloc(size > 0 ? size : 1);
+    size_t got = fread(text, 1, size > 0 ? size : 0, in);
+    fclose(in);
+    bool ok = AssembleText(text, got, filename, jobs, program);
+    free(text);
+    return ok;
+}
+
+void AsmProgramFree(AsmProgram *program) {
+    free(program->code);
+    free(program->data);
+    for(int64_t i = 0; i < program->symbol_count; i++)
+        free(program->symbols[i].name);
+    free(program->symbols);
+    memset(program, 0, sizeof(*program));
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// two-pass assembler for .s files (the ones assembly.c writes, or by hand)
+// pass 1 lays out .data from its directives (.space, .ascii, .asciiz,
+// .dword) and numbers the .code labels, pass 2 encodes each instruction
+// through the instr_info table (mnemonics found by a perfect hash)
+// no global state: threads may assemble different files at once
+// pass 2 runs on up to jobs threads (chunks of .code lines encoded into
+// their own part of the word array; same words as w/ one)
+
+// a label: .code ones at an instruction index, .data ones at a byte offset
+typedef struct {
+    char *name;
+    bool code;
+    uint64_t value;
+} AsmSymbol;
+
+// an assembled file: .code words, the .data image (big-endian) its
+// directives describe and its labels in definition order
+typedef struct {
+    uint32_t *code;
+    int64_t code_count;
+    uint8_t *data;
+    uint64_t data_size;
+    AsmSymbol *symbols;
+    int64_t symbol_count;
+} AsmProgram;
+
+// name is only used in error messages (name:line: ...)
+// false if anything failed to assemble (program holds what did)
+bool AssembleText(const char *text, size_t len, const char *name, int jobs, AsmProgram *program);
+bool AssembleFile(const char *filename, int jobs, AsmProgram *program);
+void AsmProgramFree(AsmProgram *program);
+
+#endif
\ No newline at end of file
@@ -2,33 +2,94 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "assembly.h"
+#include "instruction.h"
+#include "outliner.h"
+#include "peephole.h"
+#include "scheduler.h"
+#include "runtime.h"
+#include "regalloc.h"
+#include "burs.h"
+#include "constants.h"
+#include "data_layout.h"
+#include "string_pool.h"
 #include "symbol_table.h"
 #include "ast.h"
 
-// string table for storing string literals
-typedef struct {
-    char *label;
-    char *value;
-} StringEntry;
-
-static StringEntry string_table[100];
-static int string_count = 0;
-static int string_label_counter = 0;
-
-// track w/c vars have been initialized
-static char *initialized_vars[100];
-static int init_var_count = 0;
+// instructions for .code are built here as IR; the .s file is only a
+// printed view of it and the encoder works on it directly
+static InstrBuffer code;
+// where Emit appends: code, or a codegen thread's own buffer (spliced
+// into code in statement order afterwards)
+static _Thread_local InstrBuffer *emit_to = &code;
+static bool outline_enabled = false;
+static bool peephole_enabled = true;
+static bool peephole_stats = false;
+static bool schedule_enabled = true;
+static LatencyModel latency;
+static bool latency_set = false;
+static bool buffered_output = false;
+static bool line_comments = false;
+static char *data_text = NULL; // .data section of the last program
+static size_t data_len = 0;
 
 // r4 for syscall arguments
-// r10-r19 for temporary calculations
+// r10-r19 for temporary calculations (a pool; values that don't fit spill
+// to _spillN slots in .data)
+// r1 is the reload scratch when the pool is empty
 static int temp_start = 10;
-static int temp_next = 10;
 static int temp_max = 19;
+static _Thread_local bool temp_busy[32];
+#define REG_SCRATCH 1
 
-// get or create label for a string literal
-static char* GetStringLabel(const char *str) {
-    // process escape sequences
+// spill slots: depth of nested spills in use, and the symbol ids of the
+// _spillN slots created so far (one per nesting level ever reached)
+// codegen emits slot n as sym SPILL_PLACEHOLDER(n), ResolveSpillSlots
+// creates the slots in code order once the statements are spliced
+static _Thread_local int spill_depth = 0;
+static int spill_max = 0;
+static int *spill_syms = NULL;
+
+// print plan: literal text (string parts, constant ints, FIX 16 newlines) is
+// merged at compile time across parts and statements and printed w/ one
+// syscall 5 right b4 the next dynamic part, or at program end
+static const char **print_flush = NULL; // per dynamic part in program order: label to print first (or NULL)
+static int print_flush_count = 0;
+static int print_flush_capacity = 0;
+static _Thread_local int print_cursor = 0;
+static int *stmt_flush_start = NULL; // per statement: print_cursor at its start
+static const char *final_flush = NULL;
+static char *pending_text = NULL;
+static size_t pending_len = 0;
+
+// per symbol id: value node of a store that can become a .dword (or NULL)
+static Node **static_init = NULL;
+
+// per symbol id: statement index of the first string store to a ch var
+// (INT_MAX if none); b4 it the var prints as 0
+static int *ch_first_store = NULL;
+// statement being planned / lowered (per thread)
+static _Thread_local int current_statement = 0;
+// its source position, stamped on everything Emit appends (0: none)
+static _Thread_local int current_line = 0;
+static _Thread_local int current_column = 0;
+
+// parallel codegen: statement ranges are lowered on threads into their own
+// buffers; everything codegen reads is planned b4 (print cursor per
+// statement, spill slots resolved after the splice)
+static int codegen_jobs = 0; // 0: one per CPU
+#define PARALLEL_MIN_STATEMENTS 1024
+#define RANGES_PER_JOB 4
+
+// max vars whose interval can open in one statement (a print w/ many parts)
+#define VAR_ZERO_MAX 64
+
+// process escape sequences of a literal as written in the source
+static char* ProcessEscapes(const char *str) {
     char *processed_str = malloc(strlen(str) * 2 + 1);
     char *dst = processed_str;
     
@@ -50,73 +111,172 @@ static char* GetStringLabel(const char *str) {
         }
     }
     *dst = '\0';
-    
-    // check if string alr exists
-    for(int i = 0; i < string_count; i++) {
-        if(strcmp(string_table[i].value, processed_str) == 0) {
-            free(processed_str);
-            return string_table[i].label;
+    return processed_str;
+}
+
+// get or create label for a string literal
+static const char* GetStringLabel(const char *str) {
+    return StringPoolIntern(ProcessEscapes(str));
+}
+
+// label of a literal CollectSymbolsFromAST alr interned (lookup only)
+static const char* FindStringLabel(const char *str) {
+    char *text = ProcessEscapes(str);
+    const char *label = StringPoolLabel(text);
+    free(text);
+    return label;
+}
+
+// append one instruction to the code buffer
+static void Emit(Opcode op, int rd, int rs, int rt, int sym, long long imm) {
+    Instruction ins = { .op = op, .rd = rd, .rs = rs, .rt = rt, .sym = sym, .imm = imm,
+                        .line = current_line, .column = current_column };
+    InstrAppend(emit_to, ins);
+}
+
+// op rd, rs, rt (also dmult/ddiv rs, rt and mflo rd)
+static void EmitR(Opcode op, int rd, int rs, int rt) {
+    Emit(op, rd, rs, rt, -1, 0);
+}
+
+// daddiu rd, rs, #imm
+static void EmitImmediate(int rd, int rs, long long imm) {
+    Emit(OPC_DADDIU, rd, rs, 0, -1, imm);
+}
+
+// ld/sd reg, sym(r0)
+static void EmitMemory(Opcode op, int reg, int sym) {
+    Emit(op, reg, 0, 0, sym, 0);
+}
+
+static void EmitSyscall(int number) {
+    Emit(OPC_SYSCALL, 0, 0, 0, -1, number);
+}
+
+// symbol id of spill slot n, created in .data on first use
+static int SpillSlot(int n) {
+    if(n >= spill_max) {
+        spill_syms = realloc(spill_syms, sizeof(int) * (n + 1));
+        for(int i = spill_max; i <= n; i++) {
+            char name[32];
+            sprintf(name, "_spill%d", i);
+            spill_syms[i] = AddDataSlot(name);
         }
+        spill_max = n + 1;
     }
-    
-    // create new string entry
-    if(string_count >= 100) {
-        free(processed_str);
-        return NULL;
-    }
-    
-    string_table[string_count].value = processed_str;
-    char *label = malloc(20);
-    sprintf(label, "str%d", string_label_counter++);
-    string_table[string_count].label = label;
-    
-    string_count++;
-    return label;
+    return spill_syms[n];
 }
 
-// mark variable as initialized
-static void mark_initialized(const char *name) {
-    for(int i = 0; i < init_var_count; i++) {
-        if(strcmp(initialized_vars[i], name) == 0)
-            return;
+// sym of spill slot n in freshly lowered code (-1 is "no symbol")
+#define SPILL_PLACEHOLDER(n) (-2 - (n))
+
+// placeholders -> real slots, created in the order serial codegen would
+static void ResolveSpillSlots(InstrBuffer *buf) {
+    for(int i = 0; i < buf->count; i++) {
+        if(buf->code[i].sym <= SPILL_PLACEHOLDER(0))
+            buf->code[i].sym = SpillSlot(SPILL_PLACEHOLDER(0) - buf->code[i].sym);
     }
-    if(init_var_count < 100) {
-        initialized_vars[init_var_count++] = strdup(name);
+}
+
+// allocate a free temporary reg (r10-r19), -1 if the pool is empty
+static int NewTempRegister() {
+    for(int r = temp_start; r <= temp_max; r++) {
+        if(!temp_busy[r]) {
+            temp_busy[r] = true;
+            return r;
+        }
     }
+    return -1;
 }
 
-// initialize assembly generator
-void AssemblyInit() {
-    temp_next = temp_start;
-    init_var_count = 0;
+// give a temp back (var regs, r4 etc. are ignored)
+static void FreeTempRegister(int reg) {
+    if(reg >= temp_start && reg <= temp_max)
+        temp_busy[reg] = false;
 }
 
-// allocate a temporary reg (r10-r19)
-static int NewTempRegister() {
-    int r = temp_next++;
-    if(temp_next > temp_max)
-        temp_next = temp_start;
-    return r;
+static bool IsTempRegister(int reg) {
+    return reg >= temp_start && reg <= temp_max;
+}
+
+static int FreeTempCount() {
+    int n = 0;
+    for(int r = temp_start; r <= temp_max; r++)
+        n += !temp_busy[r];
+    return n;
 }
 
 // reset temporary reg allocation
 static void ResetTempRegister() {
-    temp_next = temp_start;
+    for(int r = temp_start; r <= temp_max; r++)
+        temp_busy[r] = false;
+}
+
+// initialize assembly generator
+void AssemblyInit() {
+    ResetTempRegister();
+    spill_depth = 0;
+    AssemblyFree();
+}
+
+// -Os switch: outline repeated instruction sequences
+void AssemblySetOutlining(bool enabled) {
+    outline_enabled = enabled;
+}
+
+// list scheduling (on by default, not w/ -Os); model NULL keeps the current one
+void AssemblySetScheduling(bool enabled, const LatencyModel *model) {
+    schedule_enabled = enabled;
+    if(model) {
+        latency = *model;
+        latency_set = true;
+    }
+}
+
+// --buffered-output: prints go through the runtime's output buffer
+void AssemblySetBufferedOutput(bool enabled) {
+    buffered_output = enabled;
+}
+
+// --jobs=N: threads for per-statement codegen (0 = one per online CPU,
+// and only for programs big enough to be worth it)
+void AssemblySetJobs(int jobs) {
+    codegen_jobs = jobs;
+}
+
+// --line-comments: mark the source line of each run of instructions in the .s
+void AssemblySetLineComments(bool enabled) {
+    line_comments = enabled;
+}
+
+// peephole pass (on by default); stats go to stderr
+void AssemblySetPeephole(bool enabled, bool stats) {
+    peephole_enabled = enabled;
+    peephole_stats = stats;
 }
 
-// load var from memory
-static void LoadVariable(FILE *out, int reg, const char *name) {
-    fprintf(out, "ld r%d, %s(r0)\n", reg, name);
+// load var (symbol id) from memory
+static void LoadVariable(int reg, int sym) {
+    EmitMemory(OPC_LD, reg, sym);
 }
 
-// store var to memory
-static void StoreVariable(FILE *out, int reg, const char *name) {
-    fprintf(out, "sd r%d, %s(r0)\n", reg, name);
+// store var (symbol id) to memory
+static void StoreVariable(int reg, int sym) {
+    EmitMemory(OPC_SD, reg, sym);
 }
 
 // load immediate value into register
-static void GenerateLoadImmediate(FILE *out, int reg, long long imm) {
-    fprintf(out, "daddiu r%d, r0, #%lld\n", reg, imm);
+// any 64-bit value: MaterializeConstants (constants.c) rewrites the ones
+// daddiu can't encode
+static void GenerateLoadImmediate(int reg, long long imm) {
+    EmitImmediate(reg, 0, imm);
+}
+
+// register the var a NODE_ID names and keep its symbol id on the node
+// (codegen reads id->sym from then on, no name lookups per use)
+static void CollectVariable(Node *id, bool is_string) {
+    AllocateRegisterForTheSymbol(id->str_val, is_string);
+    id->sym = SymbolIndex(id->str_val);
 }
 
 // collect symbols and strings from AST
@@ -136,20 +296,20 @@ static void CollectSymbolsFromAST(Node *node) {
                 while(item) {
                     if(item->node_type == 2) {
                         // simple declaration: int x
-                        AllocateRegisterForTheSymbol(item->str_val, false, NULL);
+                        CollectVariable(item, false);
                     } else if(item->node_type == 3 && item->binop.op == '=') {
                         // initialized declaration: int x = expr
                         if(item->binop.left && item->binop.left->node_type == 2) {
-                            AllocateRegisterForTheSymbol(item->binop.left->str_val, false, NULL);
+                            CollectVariable(item->binop.left, false);
                         }
                         CollectSymbolsFromAST(item->binop.right);
                     }
-                    // FIX 24: store ch in .data
+                    // FIX 24: ch var is a pointer slot in .data
                     else if(item->node_type == NODE_STR_ASSIGN) {
                         // string assignment: ch name = "string"
                         if(item->str_assign.id && item->str_assign.id->node_type == 2 &&
                            item->str_assign.str && item->str_assign.str->node_type == 1) {
-                            AllocateRegisterForTheSymbol(item->str_assign.id->str_val, true, item->str_assign.str->str_val);
+                            CollectVariable(item->str_assign.id, true);
                         }
                         if(item->str_assign.str && item->str_assign.str->node_type == 1) {
                             GetStringLabel(item->str_assign.str->str_val); // add to str table for .asciiz
@@ -165,7 +325,7 @@ static void CollectSymbolsFromAST(Node *node) {
                 while(assign) {
                     if(assign->node_type == 3 && assign->binop.op == '=') {
                         if(assign->binop.left && assign->binop.left->node_type == 2) {
-                            AllocateRegisterForTheSymbol(assign->binop.left->str_val, false, NULL); // FIX 24
+                            CollectVariable(assign->binop.left, false); // FIX 24
                         }
                         CollectSymbolsFromAST(assign->binop.right);
                     }
@@ -173,12 +333,8 @@ static void CollectSymbolsFromAST(Node *node) {
                         // string assignment: name = "string"
                         if(assign->str_assign.id && assign->str_assign.id->node_type == 2 &&
                            assign->str_assign.str && assign->str_assign.str->node_type == 1) {
-                            // check if var exists, update if needed
-                            AllocateRegisterForTheSymbol(
-                                assign->str_assign.id->str_val,
-                                true,  // is_string = true
-                                assign->str_assign.str->str_val
-                            );
+                            // check if var exists, mark it as ch if needed
+                            CollectVariable(assign->str_assign.id, true);
                             GetStringLabel(assign->str_assign.str->str_val);
                         }
                     }
@@ -190,16 +346,12 @@ static void CollectSymbolsFromAST(Node *node) {
             case 6: { // NODE_PRINT - print statement
                 Node *part = current->print_stmt.parts;
                 while(part) {
+                    // literal text is merged later by PlanPrints
                     if(part->node_type == 7) {  // NODE_PRINT_PART
                         Node *content = part->list.items;
-                        if(content && content->node_type == 1) {
-                            GetStringLabel(content->str_val);
-                        } else {
+                        if(content && content->node_type != 1)
                             CollectSymbolsFromAST(content);
-                        }
-                    } else if(part->node_type == 1) {
-                        GetStringLabel(part->str_val);
-                    } else {
+                    } else if(part->node_type != 1) {
                         CollectSymbolsFromAST(part);
                     }
                     part = part->list.next;
@@ -213,7 +365,7 @@ static void CollectSymbolsFromAST(Node *node) {
                 break;
                 
             case 2: // NODE_ID - variable reference
-                AllocateRegisterForTheSymbol(current->str_val, false, NULL);
+                CollectVariable(current, false);
                 break;
                 
             case 7: // NODE_PRINT_PART
@@ -225,97 +377,408 @@ static void CollectSymbolsFromAST(Node *node) {
     }
 }
 
-// generate code for an expression
-static int GenerateExpression(Node *node, FILE *out, int target_reg) {
+static void AppendPending(const char *text) {
+    size_t len = strlen(text);
+    pending_text = realloc(pending_text, pending_len + len + 1);
+    memcpy(pending_text + pending_len, text, len + 1);
+    pending_len += len;
+}
+
+// label for the text gathered so far (NULL if none), pending text is cleared
+static const char* TakePending() {
+    if(pending_len == 0)
+        return NULL;
+    const char *label = StringPoolIntern(pending_text);
+    pending_text = NULL;
+    pending_len = 0;
+    return label;
+}
+
+// ch var part: is a string stored in it yet?
+static bool IsStringVar(Node *content) {
+    return content->node_type == 2 && IsStringSymbolId(content->sym); // NODE_ID
+}
+
+// no store in an earlier statement (a print never stores)
+static bool IsUnsetString(Node *content) {
+    return IsStringVar(content) && ch_first_store[content->sym] >= current_statement;
+}
+
+// ch stores of a decl/assignment, in program order
+static void NoteStringStores(Node *stmt) {
+    for(Node *item = stmt->list.items; item; item = item->list.next) {
+        if(item->node_type == NODE_STR_ASSIGN && item->str_assign.id) {
+            int sym = item->str_assign.id->sym;
+            if(ch_first_store[sym] == INT_MAX)
+                ch_first_store[sym] = current_statement;
+        }
+    }
+}
+
+// string literals and expressions that fold to a constant print the same
+// text every time (so does a ch var w/ nothing stored yet: 0)
+static bool IsLiteralPart(Node *content) {
+    if(content->node_type == 1) // NODE_STR
+        return true;
+    if(IsStringVar(content)) // (BURS folds it to 0: only right in an expression)
+        return IsUnsetString(content);
+    BursLabel(content);
+    return content->burs && content->burs->cost[NT_CON] < BURS_INF;
+}
+
+static void PlanPrint(Node *node) {
+    Node *last = NULL;
+    for(Node *part = node->print_stmt.parts; part; part = part->list.next) {
+        Node *content = part->node_type == 7 ? part->list.items : part;
+        if(!content)
+            continue;
+        last = content;
+        if(content->node_type == 1) {
+            char *text = ProcessEscapes(content->str_val);
+            AppendPending(text);
+            free(text);
+        } else if(IsUnsetString(content)) {
+            AppendPending("0");
+        } else if(IsLiteralPart(content)) {
+            char digits[32];
+            sprintf(digits, "%lld", content->burs->value);
+            AppendPending(digits);
+        } else {
+            if(print_flush_count >= print_flush_capacity) {
+                print_flush_capacity = print_flush_capacity ? print_flush_capacity * 2 : 64;
+                print_flush = realloc(print_flush, sizeof(char*) * print_flush_capacity);
+            }
+            print_flush[print_flush_count++] = TakePending();
+        }
+        BursReset();
+    }
+    // FIX 16: \n after the line unless it ends w/ a string (literal or ch var)
+    if(last && last->node_type != 1 && !(IsStringVar(last) && !IsUnsetString(last)))
+        AppendPending("\n");
+}
+
+// merge the literal text of all prints (registers the merged strings)
+// also records where each statement's prints start in print_flush, so any
+// statement can be lowered on its own
+static void PlanPrints(Node *program, int stmt_count) {
+    print_flush_count = 0;
+    free(ch_first_store);
+    ch_first_store = malloc(sizeof(int) * (SymbolCount() + 1));
+    for(int i = 0; i <= SymbolCount(); i++)
+        ch_first_store[i] = INT_MAX;
+    free(stmt_flush_start);
+    stmt_flush_start = malloc(sizeof(int) * (stmt_count + 1));
+    current_statement = 0;
+    for(Node *stmt = program; stmt; stmt = stmt->list.next) {
+        stmt_flush_start[current_statement] = print_flush_count;
+        if(stmt->node_type == 4 || stmt->node_type == 5) // NODE_DECL, NODE_ASSIGN
+            NoteStringStores(stmt);
+        else if(stmt->node_type == 6) // NODE_PRINT
+            PlanPrint(stmt);
+        current_statement++;
+    }
+    final_flush = TakePending();
+}
+
+// print the string r4 points at (syscall 5, or into the runtime buffer)
+static void EmitPrintString() {
+    if(buffered_output)
+        Emit(OPC_JAL, 0, 0, 0, -1, RuntimeRoutine(RT_PUTSTR));
+    else
+        EmitSyscall(5);
+}
+
+// print merged literal text
+static void EmitFlush(const char *label) {
+    if(!label)
+        return;
+    Emit(OPC_DADDIU, 4, 0, 0, SymbolIndex(label), 0);
+    EmitPrintString();
+}
+
+// print the int in r4
+static void EmitPrintInt() {
+    if(buffered_output)
+        Emit(OPC_JAL, 0, 0, 0, -1, RuntimeRoutine(RT_PUTINT));
+    else
+        EmitSyscall(1);
+}
+
+// mark every var an expression reads
+static void MarkReads(Node *expr, bool *read) {
+    if(!expr)
+        return;
+    if(expr->node_type == 2) { // NODE_ID
+        if(expr->sym >= 0)
+            read[expr->sym] = true;
+    } else if(expr->node_type == 3) { // NODE_BINOP
+        MarkReads(expr->binop.left, read);
+        MarkReads(expr->binop.right, read);
+    } else if(expr->node_type == 7) { // NODE_PRINT_PART
+        MarkReads(expr->list.items, read);
+    }
+}
+
+// x = expr item of a decl/assignment
+static void NoteStore(Node *item, bool *read, bool *stored) {
+    if(item->node_type != 3 || item->binop.op != '=' || !item->binop.left)
+        return;
+    MarkReads(item->binop.right, read);
+    int sym = item->binop.left->sym;
+    if(sym < 0)
+        return;
+    // first store w/ nothing reading the var b4 it: may run at load time
+    if(!stored[sym] && !read[sym])
+        static_init[sym] = item->binop.right;
+    stored[sym] = true;
+}
+
+// find the first store of each var (program is straight-line), if no read
+// comes b4 it; GenerateStore turns those w/ a constant value into .dword
+static void CollectStaticInits(Node *program) {
+    int count = SymbolCount();
+    free(static_init);
+    static_init = calloc(count + 1, sizeof(Node*));
+    bool *read = calloc(count + 1, sizeof(bool));
+    bool *stored = calloc(count + 1, sizeof(bool));
+    for(Node *stmt = program; stmt; stmt = stmt->list.next) {
+        if(stmt->node_type == 4 || stmt->node_type == 5) { // NODE_DECL, NODE_ASSIGN
+            for(Node *item = stmt->list.items; item; item = item->list.next)
+                NoteStore(item, read, stored);
+        } else if(stmt->node_type == 6) { // NODE_PRINT
+            for(Node *part = stmt->print_stmt.parts; part; part = part->list.next)
+                MarkReads(part, read);
+        }
+    }
+    free(read);
+    free(stored);
+}
+
+// Sethi-Ullman number of the tile cover: temps needed to evaluate node
+// as a register w/o spilling (resident vars and r0 need none, constant
+// operands folded into daddiu need none either)
+// stored on the node so each statement is labelled once
+static int LabelExpression(Node *node) {
+    if(!node)
+        return 0;
+    if(node->node_type == 7) // NODE_PRINT_PART
+        return node->reg_need = LabelExpression(node->list.items);
+    
+    const Tile *tile = BursTile(node, NT_REG);
+    if(!tile)
+        return node->reg_need = 0;
+    
+    switch(tile->emit) {
+        case EMIT_ZERO:
+        case EMIT_ID_REG:
+            return node->reg_need = 0;
+        case EMIT_LOAD_CON:
+        case EMIT_ID_MEM:
+            return node->reg_need = 1;
+        case EMIT_PASS:
+        case EMIT_RI:
+        case EMIT_NEG: {
+            Node *kid = tile->reg_kid ? node->binop.right : node->binop.left;
+            int need = LabelExpression(kid);
+            if(tile->emit == EMIT_PASS)
+                return node->reg_need = need;
+            return node->reg_need = need > 0 ? need : 1;
+        }
+        case EMIT_RR: {
+            int l = LabelExpression(node->binop.left);
+            int r = LabelExpression(node->binop.right);
+            int need = l == r ? l + 1 : (l > r ? l : r);
+            return node->reg_need = need > 0 ? need : 1;
+        }
+    }
+    return node->reg_need = 0;
+}
+
+// pick the instruction tiles for an expression (BURS) and label the
+// cover w/ Sethi-Ullman numbers; must run b4 GenerateExpression
+static void SelectExpression(Node *node) {
+    BursLabel(node);
+    LabelExpression(node);
+}
+
+// emit the operation itself: dest = left op right
+static void EmitBinop(int op, int dest, int left_reg, int right_reg) {
+    switch(op) {
+        case '+':
+            EmitR(OPC_DADDU, dest, left_reg, right_reg);
+            break;
+        case '-':
+            EmitR(OPC_DSUBU, dest, left_reg, right_reg);
+            break;
+        case '*':
+            EmitR(OPC_DMULT, 0, left_reg, right_reg);
+            EmitR(OPC_MFLO, dest, 0, 0);
+            break;
+        case '/':
+            EmitR(OPC_DDIV, 0, left_reg, right_reg);
+            EmitR(OPC_MFLO, dest, 0, 0);
+            break;
+    }
+}
+
+// destination for a tile's result: the requested target or a new temp
+static int ResultRegister(int target_reg) {
+    if(target_reg)
+        return target_reg;
+    int reg = NewTempRegister();
+    return reg < 0 ? REG_SCRATCH : reg;
+}
+
+// generate code for an expression by expanding the selected tiles
+// target_reg != 0: result must end up there (written only by the last
+// instruction, so it may also be an operand's register)
+// target_reg == 0: result is a temp, a resident var's register or r0
+// call SelectExpression on the statement's expression first
+static int GenerateExpression(Node *node, int target_reg) {
     if(!node)
         return 0;
     
     // handle NODE_PRINT_PART wrapper
     if(node->node_type == 7) {
-        return GenerateExpression(node->list.items, out, target_reg);
+        return GenerateExpression(node->list.items, target_reg);
     }
-
-    switch(node->node_type) {
-        case 0: { // NODE_NUM - number literal
-            int reg = target_reg ? target_reg : NewTempRegister();
-            GenerateLoadImmediate(out, reg, node->int_val);
+    
+    const Tile *tile = BursTile(node, NT_REG);
+    if(!tile)
+        return 0;
+    
+    switch(tile->emit) {
+        case EMIT_ZERO: // r0 already holds 0
+            if(target_reg) {
+                EmitR(OPC_DADDU, target_reg, 0, 0);
+                return target_reg;
+            }
+            return 0;
+        
+        case EMIT_LOAD_CON: { // constant (possibly folded)
+            int reg = ResultRegister(target_reg);
+            GenerateLoadImmediate(reg, node->burs->value);
             return reg;
         }
-            
-        case 2: { // NODE_ID - var reference
-            if(target_reg) {
-                // load directly into target register
-                fprintf(out, "ld r%d, %s(r0)\n", target_reg, node->str_val);
+        
+        case EMIT_ID_REG: { // register-resident var: used in place
+            int var_reg = GetRegisterOfSymbolId(node->sym);
+            if(target_reg && target_reg != var_reg) {
+                EmitR(OPC_DADDU, target_reg, var_reg, 0);
                 return target_reg;
+            }
+            return var_reg;
+        }
+        
+        case EMIT_ID_MEM: {
+            int reg = ResultRegister(target_reg);
+            LoadVariable(reg, node->sym);
+            return reg;
+        }
+        
+        case EMIT_PASS: // x + 0, x * 1, ...: the operand is the result
+            return GenerateExpression(tile->reg_kid ? node->binop.right : node->binop.left, target_reg);
+        
+        case EMIT_RI:
+        case EMIT_NEG: {
+            Node *kid = tile->reg_kid ? node->binop.right : node->binop.left;
+            Node *con = tile->reg_kid ? node->binop.left : node->binop.right;
+            int src = GenerateExpression(kid, 0);
+            FreeTempRegister(src);
+            int dest = ResultRegister(target_reg);
+            if(tile->emit == EMIT_NEG) {
+                EmitR(OPC_DSUBU, dest, 0, src);
             } else {
-                // load into temporary register
-                int reg = NewTempRegister();
-                fprintf(out, "ld r%d, %s(r0)\n", reg, node->str_val);
-                return reg;
+                long long imm = con->burs->value;
+                if(node->binop.op == '-')
+                    imm = -imm;
+                EmitImmediate(dest, src, imm);
             }
+            return dest;
         }
+        
+        case EMIT_RR: {
+            // evaluate the side needing more registers first (left on a tie)
+            // so fewer values are held while the other side is computed
+            Node *left = node->binop.left;
+            Node *right = node->binop.right;
+            bool right_first = right->reg_need > left->reg_need;
+            Node *first = right_first ? right : left;
+            Node *second = right_first ? left : right;
             
-        case 3: { // NODE_BINOP - binary operation
-            // for binary ops w/ target_reg (can be optimized)
-            if(target_reg) {
-                // evaluate left into temp
-                int left_reg = GenerateExpression(node->binop.left, out, 0);
-                
-                // if operation is commutative (+, *), it could be potentially
-                // evaluated right into target_reg if it's simple
-                int right_reg = GenerateExpression(node->binop.right, out, 0);
-                
-                // generate operation w/ target_reg as destination
-                switch(node->binop.op) {
-                    case '+':
-                        fprintf(out, "daddu r%d, r%d, r%d\n", target_reg, left_reg, right_reg);
-                        break;
-                    case '-':
-                        fprintf(out, "dsubu r%d, r%d, r%d\n", target_reg, left_reg, right_reg);
-                        break;
-                    case '*':
-                        fprintf(out, "dmult r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", target_reg);
-                        break;
-                    case '/':
-                        fprintf(out, "ddiv r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", target_reg);
-                        break;
-                }
-                
-                return target_reg;
-            } else {
-                // no target_reg specified, use normal evaluation
-                int left_reg = GenerateExpression(node->binop.left, out, 0);
-                int right_reg = GenerateExpression(node->binop.right, out, 0);
-                int result_reg = NewTempRegister();
-                
-                switch(node->binop.op) {
-                    case '+':
-                        fprintf(out, "daddu r%d, r%d, r%d\n", result_reg, left_reg, right_reg);
-                        break;
-                    case '-':
-                        fprintf(out, "dsubu r%d, r%d, r%d\n", result_reg, left_reg, right_reg);
-                        break;
-                    case '*':
-                        fprintf(out, "dmult r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", result_reg);
-                        break;
-                    case '/':
-                        fprintf(out, "ddiv r%d, r%d\n", left_reg, right_reg);
-                        fprintf(out, "mflo r%d\n", result_reg);
-                        break;
-                }
-                
-                return result_reg;
+            int first_reg = GenerateExpression(first, 0);
+            
+            // not enough temps left for the other side: park the first
+            // result in a .data spill slot and reload it afterwards
+            int slot = -1;
+            if(IsTempRegister(first_reg) && FreeTempCount() < second->reg_need) {
+                slot = spill_depth++;
+                EmitMemory(OPC_SD, first_reg, SPILL_PLACEHOLDER(slot));
+                FreeTempRegister(first_reg);
             }
+            
+            int second_reg = GenerateExpression(second, 0);
+            
+            if(slot >= 0) {
+                first_reg = NewTempRegister();
+                if(first_reg < 0)
+                    first_reg = REG_SCRATCH;
+                EmitMemory(OPC_LD, first_reg, SPILL_PLACEHOLDER(slot));
+                spill_depth--;
+            }
+            
+            int left_reg = right_first ? second_reg : first_reg;
+            int right_reg = right_first ? first_reg : second_reg;
+            
+            // operands are dead after this op, so the result can reuse one
+            FreeTempRegister(left_reg);
+            FreeTempRegister(right_reg);
+            int result_reg = ResultRegister(target_reg);
+            
+            EmitBinop(node->binop.op, result_reg, left_reg, right_reg);
+            return result_reg;
         }
     }
     
     return 0;
 }
 
-static void GenerateDeclaration(Node *node, FILE *out) {
+// id = expr
+// register-resident vars are computed straight into their register (no sd);
+// vars left in memory go through r4 and are stored
+static void GenerateStore(Node *id, Node *value) {
+    int sym = id->sym;
+    int var_reg = GetRegisterOfSymbolId(sym);
+    SelectExpression(value);
+    
+    // constant first store of a memory var: initialised in .data instead
+    if(var_reg == 0 && sym >= 0 && static_init && static_init[sym] == value &&
+       value->burs && value->burs->cost[NT_CON] < BURS_INF) {
+        SetInitialValueOfSymbolId(sym, value->burs->value);
+        return;
+    }
+    
+    if(var_reg > 0) {
+        int reg = GenerateExpression(value, var_reg);
+        if(reg != var_reg)
+            EmitR(OPC_DADDU, var_reg, reg, 0);
+        return;
+    }
+    
+    // evaluate expression into r4
+    GenerateExpression(value, 4);
+    
+    // store from r4 to memory
+    StoreVariable(4, sym);
+}
+
+// id = "string": the ch var points at the (shared) literal
+static void GenerateStringStore(Node *id, const char *str) {
+    Emit(OPC_DADDIU, 4, 0, 0, SymbolIndex(FindStringLabel(str)), 0);
+    StoreVariable(4, id->sym);
+}
+
+static void GenerateDeclaration(Node *node) {
     if(!node || node->node_type != 4)
         return;
     
@@ -325,15 +788,8 @@ static void GenerateDeclaration(Node *node, FILE *out) {
             Node *left = current->binop.left;
             Node *right = current->binop.right;
             
-            // allocate symbol (integer)
-            AllocateRegisterForTheSymbol(left->str_val, false, NULL);
-            mark_initialized(left->str_val);
-            
-            // evaluate expression into r4
-            GenerateExpression(right, out, 4);
-            
-            // store from r4 to memory
-            fprintf(out, "sd r4, %s(r0)\n", left->str_val);
+            // (the symbol was registered by CollectSymbolsFromAST)
+            GenerateStore(left, right);
             
         } 
         // FIX 24
@@ -342,24 +798,14 @@ static void GenerateDeclaration(Node *node, FILE *out) {
             Node *left = current->str_assign.id;
             Node *right = current->str_assign.str;
             
-            // allocate symbol with string value
-            AllocateRegisterForTheSymbol(left->str_val, true, right->str_val);
-            mark_initialized(left->str_val);
-            
-            // for string vars, store the string directly in .data
-            // the variable itself contains the string, not a pointer
-            // so no need to load/store abything - it's alr in .data
-            
-        }
-        else if(current->node_type == 2) {
-            // simple declaration (no initialization)
-            AllocateRegisterForTheSymbol(current->str_val, false, NULL);
+            GenerateStringStore(left, right->str_val);
         }
+        // (simple declaration w/o initialization: nothing to emit)
         current = current->list.next;
     }
 }
 
-static void GenerateAssignment(Node *node, FILE *out) {
+static void GenerateAssignment(Node *node) {
     if(!node || node->node_type != 5)
         return;
     
@@ -369,15 +815,7 @@ static void GenerateAssignment(Node *node, FILE *out) {
             Node *left = current->binop.left;
             Node *right = current->binop.right;
             
-            // get symbol
-            GetRegisterOfTheSymbol(left->str_val);
-            mark_initialized(left->str_val);
-            
-            // evaluate expression into r4
-            GenerateExpression(right, out, 4); 
-            
-            // store from r4 to memory
-            fprintf(out, "sd r4, %s(r0)\n", left->str_val);
+            GenerateStore(left, right);
         }
         // FIX 24
         else if(current->node_type == NODE_STR_ASSIGN) { 
@@ -385,18 +823,16 @@ static void GenerateAssignment(Node *node, FILE *out) {
             Node *left = current->str_assign.id;
             Node *right = current->str_assign.str;
             
-            // update symbol table w/ new string value
-            AllocateRegisterForTheSymbol(left->str_val, true, right->str_val);
-            mark_initialized(left->str_val);
-            
-            // string is already in .data as .asciiz
+            GenerateStringStore(left, right->str_val);
         }
         current = current->list.next;
     }
 }
 
 // generate code for print statement
-static void GeneratePrint(Node *node, FILE *out) {
+// literal parts were merged by PlanPrints; only dynamic parts emit code here,
+// preceded by the literal text gathered since the last one
+static void GeneratePrint(Node *node) {
     if(!node || node->node_type != 6)
         return;
     
@@ -408,105 +844,303 @@ static void GeneratePrint(Node *node, FILE *out) {
             content = current->list.items;
         }
         
-        if(content && content->node_type == 1) {  // string literal
-            char *label = GetStringLabel(content->str_val);
-            if(label) {
-                fprintf(out, "daddiu r4, r0, %s\n", label);
-                fprintf(out, "syscall 5\n");
+        if(content && !IsLiteralPart(content)) {
+            if(print_cursor < print_flush_count)
+                EmitFlush(print_flush[print_cursor++]);
+            if(IsStringVar(content)) {
+                // FIX 24: ch var holds a pointer to its text
+                LoadVariable(4, content->sym);
+                EmitPrintString();
+            } else {
+                SelectExpression(content);
+                GenerateExpression(content, 4);
+                EmitPrintInt();
             }
         }
-        // FIX 24
-        else if(content && content->node_type == 2) {  // variable reference
-            // need to check if it's a string variable
-            // for now, assume integer and use syscall 1
-            GenerateExpression(content, out, 4);  // Load value
-            fprintf(out, "syscall 1\n");  // Print integer
-        }
-        else if(content) {  // expression
-            GenerateExpression(content, out, 4);  // target reg = 4
-            fprintf(out, "syscall 1\n");
-        }
+        BursReset();
         current = current->list.next;
     }
 }
 
 // generate code for a single AST node
-void GenerateAssemblyNode(Node *node, FILE *out) {
-    if(!node || !out)
+// instructions go to the code buffer, GenerateAssemblyProgram writes them out
+void GenerateAssemblyNode(Node *node) {
+    if(!node)
         return;
     
     ResetTempRegister();
     
     switch(node->node_type) {
         case 4: // NODE_DECL
-            GenerateDeclaration(node, out);
+            GenerateDeclaration(node);
             break;
         case 5: // NODE_ASSIGN
-            GenerateAssignment(node, out);
+            GenerateAssignment(node);
             break;
         case 6: // NODE_PRINT
-            GeneratePrint(node, out);
+            GeneratePrint(node);
             break;
         default:
             // traverse list nodes
             if(node->list.items) {
-                GenerateAssemblyNode(node->list.items, out);
+                GenerateAssemblyNode(node->list.items);
             }
             if(node->list.next) {
-                GenerateAssemblyNode(node->list.next, out);
+                GenerateAssemblyNode(node->list.next);
             }
             break;
     }
 }
 
-// generate complete assembly program
+// lower statements [first, last) into buf
+// vars read b4 any write start at 0 (their register may be recycled)
+static void LowerStatements(Node **stmts, int first, int last, InstrBuffer *buf) {
+    emit_to = buf;
+    for(int index = first; index < last; index++) {
+        current_statement = index;
+        current_line = stmts[index]->line;
+        current_column = stmts[index]->column;
+        print_cursor = stmt_flush_start[index];
+        int zero_regs[VAR_ZERO_MAX];
+        int zero_count = ZeroInitRegisters(index, zero_regs, VAR_ZERO_MAX);
+        for(int i = 0; i < zero_count; i++)
+            EmitR(OPC_DADDU, zero_regs[i], 0, 0);
+        GenerateAssemblyNode(stmts[index]);
+        BursReset();
+    }
+    current_line = current_column = 0;
+    emit_to = &code;
+}
+
+// one task of parallel codegen: a statement range and its output
+typedef struct {
+    int first;
+    int last;
+    InstrBuffer out;
+} CodegenRange;
+
+typedef struct {
+    Node **stmts;
+    CodegenRange *ranges;
+    int range_count;
+    int next_range; // next unclaimed range
+    pthread_mutex_t lock;
+} CodegenWork;
+
+// claim ranges until none are left
+static void* CodegenWorker(void *arg) {
+    CodegenWork *work = arg;
+    for(;;) {
+        pthread_mutex_lock(&work->lock);
+        int r = work->next_range++;
+        pthread_mutex_unlock(&work->lock);
+        if(r >= work->range_count)
+            break;
+        CodegenRange *range = &work->ranges[r];
+        LowerStatements(work->stmts, range->first, range->last, &range->out);
+    }
+    return NULL;
+}
+
+static void* CodegenThread(void *arg) {
+    CodegenWorker(arg);
+    BursFree();
+    return NULL;
+}
+
+// threads to lower stmt_count statements on (1: serial)
+static int CodegenJobs(int stmt_count) {
+    if(codegen_jobs > 0)
+        return codegen_jobs < stmt_count ? codegen_jobs : (stmt_count > 0 ? stmt_count : 1);
+    if(stmt_count < PARALLEL_MIN_STATEMENTS)
+        return 1;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 1 ? (int)cpus : 1;
+}
+
+// lower all statements to code: serial, or ranges on threads spliced back
+// in statement order (same instructions either way)
+static void LowerProgram(Node **stmts, int stmt_count) {
+    int jobs = CodegenJobs(stmt_count);
+    if(jobs <= 1) {
+        LowerStatements(stmts, 0, stmt_count, &code);
+    } else {
+        CodegenWork work = { .stmts = stmts, .next_range = 0 };
+        work.range_count = jobs * RANGES_PER_JOB < stmt_count ? jobs * RANGES_PER_JOB : stmt_count;
+        work.ranges = calloc(work.range_count, sizeof(CodegenRange));
+        for(int r = 0; r < work.range_count; r++) {
+            work.ranges[r].first = (int)((long long)stmt_count * r / work.range_count);
+            work.ranges[r].last = (int)((long long)stmt_count * (r + 1) / work.range_count);
+        }
+        pthread_mutex_init(&work.lock, NULL);
+
+        // this thread works too
+        pthread_t *threads = malloc(sizeof(pthread_t) * jobs);
+        int started = 0;
+        for(int t = 1; t < jobs; t++) {
+            if(pthread_create(&threads[started], NULL, CodegenThread, &work) == 0)
+                started++;
+        }
+        CodegenWorker(&work);
+        for(int t = 0; t < started; t++)
+            pthread_join(threads[t], NULL);
+        free(threads);
+        pthread_mutex_destroy(&work.lock);
+
+        for(int r = 0; r < work.range_count; r++) {
+            for(int i = 0; i < work.ranges[r].out.count; i++)
+                InstrAppend(&code, work.ranges[r].out.code[i]);
+            InstrBufferFree(&work.ranges[r].out);
+        }
+        free(work.ranges);
+    }
+    ResolveSpillSlots(&code);
+}
+
+// lower the program to instruction IR (kept until AssemblyFree for the
+// encoder); if out is not NULL the .s view is written to it as well
 void GenerateAssemblyProgram(Node *program, FILE *out) {
-    if(!program || !out)
+    if(!program)
         return;
     
     // initialize
     SymbolInit();
     AssemblyInit();
-    string_count = 0;
-    string_label_counter = 0;
+    StringPoolReset();
+    
+    // statements by index (codegen may lower them out of order)
+    int stmt_count = 0;
+    for(Node *stmt = program; stmt; stmt = stmt->list.next)
+        stmt_count++;
+    Node **stmts = malloc(sizeof(Node*) * (stmt_count + 1));
+    stmt_count = 0;
+    for(Node *stmt = program; stmt; stmt = stmt->list.next)
+        stmts[stmt_count++] = stmt;
     
     // collect all symbols and strings
     CollectSymbolsFromAST(program);
+    PlanPrints(program, stmt_count);
+    
+    // runtime buffer and its scratch data sit right after the vars
+    if(buffered_output)
+        RuntimeInit();
     
     // FIX 15: register string labels (str0, str1, ...) in the symbol table
-    for(int i = 0; i < string_count; i++)
-        AddLabel(string_table[i].label, strlen(string_table[i].value) + 1);
-    
-    // debug: print symbol table
-    PrintAllSymbols(out);
-    
-    // generate .data section
-    fprintf(out, ".data\n");
-    PrintDataSection(out);  // vars
-    
-    // generate string literals
-    for(int i = 0; i < string_count; i++) {
-        fprintf(out, "%s: .asciiz \"", string_table[i].label);
-        for(char *p = string_table[i].value; *p; p++) {
-            if(*p == '\n') fprintf(out, "\\n");
-            else if(*p == '"') fprintf(out, "\\\"");
-            else if(*p == '\\') fprintf(out, "\\\\");
-            else fputc(*p, out);
-        }
-        fprintf(out, "\"\n");
+    StringPoolLayout();
+    
+    // keep int vars in registers where possible
+    AllocateVariableRegisters(program);
+    CollectStaticInits(program);
+    
+    // generate code first: spill slots are only known after that
+    if(buffered_output)
+        Emit(OPC_DADDIU, RT_REG_CURSOR, 0, 0, RuntimeBufferSymbol(), 0);
+    LowerProgram(stmts, stmt_count);
+    free(stmts);
+    EmitFlush(final_flush);
+    if(buffered_output)
+        Emit(OPC_JAL, 0, 0, 0, -1, RuntimeRoutine(RT_FLUSH));
+    
+    // local cleanup over the whole (straight-line) program
+    if(peephole_enabled) {
+        PeepholeOptimize(&code);
+        if(peephole_stats)
+            PeepholePrintStats(stderr);
     }
-    fprintf(out, "\n.code\n");
     
-    // generate code
-    Node *current = program;
-    while(current) {
-        GenerateAssemblyNode(current, out);
-        current = current->list.next;
+    // constants daddiu can't hold become lui/ori/dsll builds or pool loads
+    MaterializeConstants(&code);
+    
+    // hide load-use and HI/LO latency (size wins under -Os)
+    if(schedule_enabled && !outline_enabled)
+        ScheduleInstructions(&code, latency_set ? &latency : &default_latency);
+    
+    // -Os: move repeated instruction runs into shared subroutines
+    if(outline_enabled)
+        OutlineRepeatedSequences(&code);
+    
+    // runtime routines go after halt (outlining adds one when it creates subroutines)
+    if(buffered_output) {
+        bool halted = false;
+        for(int i = 0; i < code.count && !halted; i++)
+            halted = code.code[i].op == OPC_HALT;
+        if(!halted)
+            Emit(OPC_HALT, 0, 0, 0, -1, 0);
+        RuntimeAppendRoutines(&code);
     }
     
-    // cleanup
-    for(int i = 0; i < string_count; i++) {
-        free(string_table[i].value);
-        free(string_table[i].label);
+    // final .data offsets (hot slots first), far symbols get a base register
+    LayoutData(&code);
+    
+    // .data section text, kept for the binary images (their .data is laid
+    // out from it by the assembler)
+    free(data_text);
+    data_text = NULL;
+    data_len = 0;
+    FILE *data = open_memstream(&data_text, &data_len);
+    fprintf(data, ".data\n");
+    PrintDataSection(data);  // vars and spill slots
+    if(buffered_output)
+        RuntimePrintData(data);
+    StringPoolPrint(data); // string literals
+    fclose(data);
+    
+    if(out) {
+        // debug: print symbol table
+        PrintAllSymbols(out);
+        
+        fwrite(data_text, 1, data_len, out);
+        fprintf(out, "\n.code\n");
+        
+        int line = -1, column = -1;
+        for(int i = 0; i < code.count; i++) {
+            const Instruction *ins = &code.code[i];
+            // --line-comments: a ; line N:C header wherever the source position changes
+            if(line_comments && ins->op != OPC_LABEL && (ins->line != line || ins->column != column)) {
+                line = ins->line;
+                column = ins->column;
+                if(line > 0)
+                    fprintf(out, "; line %d:%d\n", line, column);
+                else
+                    fprintf(out, "; no source line\n");
+            }
+            PrintInstruction(ins, out);
+        }
     }
+    
+    // cleanup (the IR stays for the encoder)
+    RegAllocFree();
+    StringPoolReset();
+}
+
+// the lowered program, valid until AssemblyFree
+const InstrBuffer* AssemblyInstructions() {
+    return &code;
+}
+
+// its .data section as .s text (".data\n" + directives), same lifetime
+const char* AssemblyDataText(size_t *len) {
+    *len = data_len;
+    return data_text;
+}
+
+void AssemblyFree() {
+    InstrBufferFree(&code);
+    CodeLabelsReset();
+    free(print_flush);
+    print_flush = NULL;
+    print_flush_count = print_flush_capacity = 0;
+    final_flush = NULL;
+    free(static_init);
+    static_init = NULL;
+    free(ch_first_store);
+    ch_first_store = NULL;
+    free(stmt_flush_start);
+    stmt_flush_start = NULL;
+    free(spill_syms);
+    spill_syms = NULL;
+    spill_max = 0;
+    free(data_text);
+    data_text = NULL;
+    data_len = 0;
 }
\ No newline at end of file
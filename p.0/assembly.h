@@ -2,10 +2,22 @@
 #define ASSEMBLY_H
 
 #include <stdio.h>
+#include <stdbool.h>
 #include "ast.h"
+#include "instruction.h"
+#include "scheduler.h"
 
 void AssemblyInit();
-void GenerateAssemblyProgram(Node *program, FILE *out);
-void GenerateAssemblyNode(Node *node, FILE *out);
+void AssemblySetOutlining(bool enabled); // -Os
+void AssemblySetPeephole(bool enabled, bool stats); // --no-peephole, --peephole-stats
+void AssemblySetBufferedOutput(bool enabled); // --buffered-output
+void AssemblySetScheduling(bool enabled, const LatencyModel *model); // --no-schedule, --latency=
+void AssemblySetJobs(int jobs); // --jobs=N (0: one per CPU on big programs)
+void AssemblySetLineComments(bool enabled); // --line-comments
+void GenerateAssemblyProgram(Node *program, FILE *out); // out == NULL: no .s text
+const InstrBuffer* AssemblyInstructions(); // lowered program (IR)
+const char* AssemblyDataText(size_t *len); // its .data section as .s text
+void AssemblyFree();
+void GenerateAssemblyNode(Node *node);
 
 #endif
\ No newline at end of file
@@ -7,6 +7,11 @@
 // AST node structure
 typedef struct Node {
     int node_type;
+    int reg_need; // Sethi-Ullman number, filled in by codegen
+    struct BursState *burs; // instruction selector labels (burs.c)
+    int line; // statement nodes: where the statement starts in the source
+    int column;
+    int sym; // NODE_ID: symbol table id, set when codegen collects the symbols (-1 b4)
     union {
         int int_val;
         char *str_val;
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "burs.h"
+#include "symbol_table.h"
+
+// bottom-up rewrite system (BURS) instruction selector for expression trees
+// every node is labelled w/ the cheapest way to get each nonterminal (dynamic
+// programming over the tile table below); codegen then walks the tiles
+// chosen for NT_REG from the root, so the cover is minimum cost
+
+// labels come from a chunked arena so node->burs pointers stay valid
+#define STATE_CHUNK 1024
+
+typedef struct StateChunk {
+    BursState states[STATE_CHUNK];
+    int used;
+    struct StateChunk *next;
+} StateChunk;
+
+// per thread: statements may be lowered in parallel (assembly.c)
+static _Thread_local StateChunk *chunks = NULL;
+
+static BursState* NewState() {
+    if(!chunks || chunks->used >= STATE_CHUNK) {
+        StateChunk *c = malloc(sizeof(StateChunk));
+        c->used = 0;
+        c->next = chunks;
+        chunks = c;
+    }
+    BursState *s = &chunks->states[chunks->used++];
+    for(int i = 0; i < NT_COUNT; i++) {
+        s->cost[i] = BURS_INF;
+        s->tile[i] = -1;
+    }
+    s->value = 0;
+    return s;
+}
+
+// keeps one chunk around for the next statement
+void BursReset() {
+    while(chunks && chunks->next) {
+        StateChunk *next = chunks->next;
+        free(chunks);
+        chunks = next;
+    }
+    if(chunks)
+        chunks->used = 0;
+}
+
+void BursFree() {
+    BursReset();
+    free(chunks);
+    chunks = NULL;
+}
+
+static bool Fits16(long long v) {
+    return v >= -32768 && v <= 32767;
+}
+
+// tile conditions (l/r are the children's labels, NULL for leaves)
+static bool IsResident(Node *n, const BursState *l, const BursState *r) {
+    return GetRegisterOfSymbolId(n->sym) > 0;
+}
+static bool IsString(Node *n, const BursState *l, const BursState *r) {
+    return IsStringSymbolId(n->sym);
+}
+static bool IsMemory(Node *n, const BursState *l, const BursState *r) {
+    return !IsResident(n, l, r) && !IsString(n, l, r);
+}
+static bool ConIsZero(Node *n, const BursState *l, const BursState *r) {
+    return l->value == 0; // chain rules pass the node's own label as l
+}
+static bool LeftZero(Node *n, const BursState *l, const BursState *r) { return l->value == 0; }
+static bool RightZero(Node *n, const BursState *l, const BursState *r) { return r->value == 0; }
+static bool LeftOne(Node *n, const BursState *l, const BursState *r) { return l->value == 1; }
+static bool RightOne(Node *n, const BursState *l, const BursState *r) { return r->value == 1; }
+static bool LeftMinusOne(Node *n, const BursState *l, const BursState *r) { return l->value == -1; }
+static bool RightMinusOne(Node *n, const BursState *l, const BursState *r) { return r->value == -1; }
+static bool LeftImm(Node *n, const BursState *l, const BursState *r) { return Fits16(l->value); }
+static bool RightImm(Node *n, const BursState *l, const BursState *r) { return Fits16(r->value); }
+static bool RightNegImm(Node *n, const BursState *l, const BursState *r) { return Fits16(-r->value); }
+
+// the tile table
+// constant tiles fold at compile time w/ the interpreter's rules (x / 0 = 0)
+// and drop pure subtrees multiplied by / dividing 0
+const Tile burs_tiles[] = {
+    // name            lhs     op        kids              cost cond           emit           reg_kid
+    { "con:num",       NT_CON, TILE_NUM, {-1, -1},         0,   NULL,          EMIT_NONE,     0 },
+    { "con:ch",        NT_CON, TILE_ID,  {-1, -1},         0,   IsString,      EMIT_NONE,     0 }, // ch as an int is 0 (its slot holds a pointer)
+    { "con:fold+",     NT_CON, '+',      {NT_CON, NT_CON}, 0,   NULL,          EMIT_NONE,     0 },
+    { "con:fold-",     NT_CON, '-',      {NT_CON, NT_CON}, 0,   NULL,          EMIT_NONE,     0 },
+    { "con:fold*",     NT_CON, '*',      {NT_CON, NT_CON}, 0,   NULL,          EMIT_NONE,     0 },
+    { "con:fold/",     NT_CON, '/',      {NT_CON, NT_CON}, 0,   NULL,          EMIT_NONE,     0 },
+    { "con:0*x",       NT_CON, '*',      {NT_CON, NT_ANY}, 0,   LeftZero,      EMIT_NONE,     0 },
+    { "con:x*0",       NT_CON, '*',      {NT_ANY, NT_CON}, 0,   RightZero,     EMIT_NONE,     0 },
+    { "con:0/x",       NT_CON, '/',      {NT_CON, NT_ANY}, 0,   LeftZero,      EMIT_NONE,     0 },
+    { "con:x/0",       NT_CON, '/',      {NT_ANY, NT_CON}, 0,   RightZero,     EMIT_NONE,     0 },
+
+    { "reg:id",        NT_REG, TILE_ID,  {-1, -1},         0,   IsResident,    EMIT_ID_REG,   0 },
+    { "reg:ld",        NT_REG, TILE_ID,  {-1, -1},         1,   IsMemory,      EMIT_ID_MEM,   0 },
+
+    { "reg:daddu",     NT_REG, '+',      {NT_REG, NT_REG}, 1,   NULL,          EMIT_RR,       0 },
+    { "reg:daddiu",    NT_REG, '+',      {NT_REG, NT_CON}, 1,   RightImm,      EMIT_RI,       0 },
+    { "reg:daddiu'",   NT_REG, '+',      {NT_CON, NT_REG}, 1,   LeftImm,       EMIT_RI,       1 },
+    { "reg:x+0",       NT_REG, '+',      {NT_REG, NT_CON}, 0,   RightZero,     EMIT_PASS,     0 },
+    { "reg:0+x",       NT_REG, '+',      {NT_CON, NT_REG}, 0,   LeftZero,      EMIT_PASS,     1 },
+
+    { "reg:dsubu",     NT_REG, '-',      {NT_REG, NT_REG}, 1,   NULL,          EMIT_RR,       0 },
+    { "reg:daddiu-",   NT_REG, '-',      {NT_REG, NT_CON}, 1,   RightNegImm,   EMIT_RI,       0 },
+    { "reg:x-0",       NT_REG, '-',      {NT_REG, NT_CON}, 0,   RightZero,     EMIT_PASS,     0 },
+    { "reg:0-x",       NT_REG, '-',      {NT_CON, NT_REG}, 1,   LeftZero,      EMIT_NEG,      1 },
+
+    { "reg:dmult",     NT_REG, '*',      {NT_REG, NT_REG}, 2,   NULL,          EMIT_RR,       0 },
+    { "reg:x*1",       NT_REG, '*',      {NT_REG, NT_CON}, 0,   RightOne,      EMIT_PASS,     0 },
+    { "reg:1*x",       NT_REG, '*',      {NT_CON, NT_REG}, 0,   LeftOne,       EMIT_PASS,     1 },
+    { "reg:x*-1",      NT_REG, '*',      {NT_REG, NT_CON}, 1,   RightMinusOne, EMIT_NEG,      0 },
+    { "reg:-1*x",      NT_REG, '*',      {NT_CON, NT_REG}, 1,   LeftMinusOne,  EMIT_NEG,      1 },
+
+    { "reg:ddiv",      NT_REG, '/',      {NT_REG, NT_REG}, 2,   NULL,          EMIT_RR,       0 },
+    { "reg:x/1",       NT_REG, '/',      {NT_REG, NT_CON}, 0,   RightOne,      EMIT_PASS,     0 },
+    { "reg:x/-1",      NT_REG, '/',      {NT_REG, NT_CON}, 1,   RightMinusOne, EMIT_NEG,      0 },
+
+    { NULL, 0, 0, {0, 0}, 0, NULL, 0, 0 }
+};
+
+// chain rules: reg <- con (applied after the base tiles)
+static const Tile chain_tiles[] = {
+    { "reg:r0",        NT_REG, -1,       {NT_CON, -1},     0,   ConIsZero,     EMIT_ZERO,     0 },
+    { "reg:li",        NT_REG, -1,       {NT_CON, -1},     1,   NULL,          EMIT_LOAD_CON, 0 },
+    { NULL, 0, 0, {0, 0}, 0, NULL, 0, 0 }
+};
+#define CHAIN_BASE 1000 // chain tiles are stored as CHAIN_BASE + index
+
+// 64-bit wrapping fold, division by zero gives 0 like the interpreter
+static long long Fold(int op, long long a, long long b) {
+    unsigned long long ua = (unsigned long long)a, ub = (unsigned long long)b;
+    switch(op) {
+        case '+': return (long long)(ua + ub);
+        case '-': return (long long)(ua - ub);
+        case '*': return (long long)(ua * ub);
+        case '/':
+            if(b == 0)
+                return 0;
+            if(a == LLONG_MIN && b == -1)
+                return a;
+            return a / b;
+    }
+    return 0;
+}
+
+static int KidCost(const BursState *s, int nt) {
+    if(nt == NT_ANY)
+        return 0;
+    return s ? s->cost[nt] : BURS_INF;
+}
+
+void BursLabel(Node *node) {
+    if(!node)
+        return;
+    if(node->node_type == 7) { // NODE_PRINT_PART
+        BursLabel(node->list.items);
+        node->burs = node->list.items ? node->list.items->burs : NULL;
+        return;
+    }
+
+    BursState *s = NewState();
+    node->burs = s;
+    BursState *l = NULL, *r = NULL;
+    int op;
+    switch(node->node_type) {
+        case 0: op = TILE_NUM; break; // NODE_NUM
+        case 2: op = TILE_ID; break; // NODE_ID
+        case 3: // NODE_BINOP
+            op = node->binop.op;
+            BursLabel(node->binop.left);
+            BursLabel(node->binop.right);
+            l = node->binop.left ? node->binop.left->burs : NULL;
+            r = node->binop.right ? node->binop.right->burs : NULL;
+            break;
+        default:
+            return;
+    }
+
+    // base tiles
+    for(int t = 0; burs_tiles[t].name; t++) {
+        const Tile *tile = &burs_tiles[t];
+        if(tile->op != op)
+            continue;
+        int cost = tile->cost;
+        if(op != TILE_NUM && op != TILE_ID)
+            cost += KidCost(l, tile->kid[0]) + KidCost(r, tile->kid[1]);
+        if(cost >= BURS_INF)
+            continue;
+        if(tile->cond && !tile->cond(node, l, r))
+            continue;
+        if(cost < s->cost[tile->lhs]) {
+            s->cost[tile->lhs] = cost;
+            s->tile[tile->lhs] = t;
+            if(tile->lhs == NT_CON) {
+                if(op == TILE_NUM)
+                    s->value = node->int_val;
+                else if(tile->kid[0] == NT_CON && tile->kid[1] == NT_CON)
+                    s->value = Fold(op, l->value, r->value);
+                else
+                    s->value = 0; // 0 * x, x / 0, a ch var ...
+            }
+        }
+    }
+
+    // chain rules
+    if(s->cost[NT_CON] < BURS_INF) {
+        for(int t = 0; chain_tiles[t].name; t++) {
+            const Tile *tile = &chain_tiles[t];
+            int cost = tile->cost + s->cost[NT_CON];
+            if(tile->cond && !tile->cond(node, s, NULL))
+                continue;
+            if(cost < s->cost[tile->lhs]) {
+                s->cost[tile->lhs] = cost;
+                s->tile[tile->lhs] = CHAIN_BASE + t;
+            }
+        }
+    }
+}
+
+const Tile* BursTile(Node *node, int nt) {
+    if(!node || !node->burs || node->burs->tile[nt] < 0)
+        return NULL;
+    int t = node->burs->tile[nt];
+    return t >= CHAIN_BASE ? &chain_tiles[t - CHAIN_BASE] : &burs_tiles[t];
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef BURS_H
+#define BURS_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// nonterminals of the expression grammar
+#define NT_REG 0 // value in a register
+#define NT_CON 1 // compile-time constant (folded)
+#define NT_ANY 2 // don't care: subtree is dropped (pure), costs nothing
+#define NT_COUNT 2 // nonterminals w/ costs (NT_ANY has none)
+
+// how codegen expands a tile
+#define EMIT_NONE 0 // constant tiles: value only
+#define EMIT_LOAD_CON 1 // daddiu rd, r0, #k
+#define EMIT_ZERO 2 // r0
+#define EMIT_ID_REG 3 // register-resident var, used in place
+#define EMIT_ID_MEM 4 // ld rd, x(r0)
+#define EMIT_RR 5 // op rd, rs, rt (dmult/ddiv + mflo)
+#define EMIT_RI 6 // daddiu rd, rs, #(+/-)k
+#define EMIT_PASS 7 // identity: result is the reg kid itself
+#define EMIT_NEG 8 // dsubu rd, r0, rs
+
+#define BURS_INF 1000000
+
+// per-node labelling: cheapest cost and tile for each nonterminal
+typedef struct BursState {
+    int cost[NT_COUNT];
+    int tile[NT_COUNT];
+    long long value; // folded value if cost[NT_CON] < BURS_INF
+} BursState;
+
+// instruction tile: lhs <- op(kid0, kid1)
+typedef struct {
+    const char *name;
+    int lhs;
+    int op; // '+', '-', '*', '/', or TILE_NUM / TILE_ID
+    int kid[2];
+    int cost; // instructions emitted by the tile itself
+    bool (*cond)(Node *node, const BursState *l, const BursState *r);
+    int emit;
+    int reg_kid; // EMIT_RI/PASS/NEG: child holding the register operand
+} Tile;
+
+#define TILE_NUM 0
+#define TILE_ID 1
+
+extern const Tile burs_tiles[];
+
+// bottom-up labelling of an expression tree (fills node->burs)
+void BursLabel(Node *node);
+// tile chosen to produce nonterminal nt at node
+const Tile* BursTile(Node *node, int nt);
+// drop all labels (call once the statement is emitted)
+void BursReset();
+// drop the arena too (a codegen thread b4 it exits)
+void BursFree();
+
+#endif
\ No newline at end of file
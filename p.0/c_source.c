@@ -0,0 +1,379 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "c_source.h"
+
+#define NODE_PRINT_PART 7
+#define NODE_STR_ASSIGN 8
+
+// longest source line of a string literal in the output
+#define LITERAL_LINE 72
+
+// a var as the interpreter would see it at this point of the program
+typedef struct {
+    char *name;
+    bool initialized;
+    bool is_string;
+    bool has_local; // assigned an int somewhere: int32_t v_<name>
+    bool read; // local read somewhere (else it gets a (void) use)
+    const char *text; // ch var: the literal it holds
+} CVar;
+
+static CVar *vars = NULL;
+static int var_count = 0;
+static int var_capacity = 0;
+
+// literal text waiting to be printed (merged across parts and statements)
+static char *pending = NULL;
+static size_t pending_len = 0;
+
+// runtime of the generated program: output buffer, ints, wrapping ops
+static const char *prelude =
+    "#include <stdio.h>\n"
+    "#include <stdint.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static char p0_buf[1 << 16];\n"
+    "static size_t p0_len = 0;\n"
+    "\n"
+    "static void p0_flush(void) {\n"
+    "    fwrite(p0_buf, 1, p0_len, stdout);\n"
+    "    p0_len = 0;\n"
+    "}\n"
+    "\n"
+    "static void p0_str(const char *s, size_t n) {\n"
+    "    if(n > sizeof(p0_buf) - p0_len) {\n"
+    "        p0_flush();\n"
+    "        if(n > sizeof(p0_buf)) {\n"
+    "            fwrite(s, 1, n, stdout);\n"
+    "            return;\n"
+    "        }\n"
+    "    }\n"
+    "    memcpy(p0_buf + p0_len, s, n);\n"
+    "    p0_len += n;\n"
+    "}\n"
+    "\n"
+    "static void p0_int(int32_t v) {\n"
+    "    char t[12];\n"
+    "    int i = sizeof(t);\n"
+    "    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;\n"
+    "    do {\n"
+    "        t[--i] = '0' + u % 10;\n"
+    "        u /= 10;\n"
+    "    } while(u);\n"
+    "    if(v < 0)\n"
+    "        t[--i] = '-';\n"
+    "    p0_str(t + i, sizeof(t) - i);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t p0_add(int32_t a, int32_t b) { return (int32_t)((uint32_t)a + (uint32_t)b); }\n"
+    "static inline int32_t p0_sub(int32_t a, int32_t b) { return (int32_t)((uint32_t)a - (uint32_t)b); }\n"
+    "static inline int32_t p0_mul(int32_t a, int32_t b) { return (int32_t)((uint32_t)a * (uint32_t)b); }\n"
+    "static inline int32_t p0_div(int32_t a, int32_t b) {\n"
+    "    if(b == 0)\n"
+    "        return 0;\n"
+    "    if(b == -1)\n"
+    "        return p0_sub(0, a);\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n";
+
+static CVar* FindVar(const char *name) {
+    for(int i = 0; i < var_count; i++) {
+        if(strcmp(vars[i].name, name) == 0)
+            return &vars[i];
+    }
+    return NULL;
+}
+
+static CVar* GetVar(const char *name) {
+    CVar *var = FindVar(name);
+    if(var)
+        return var;
+    if(var_count >= var_capacity) {
+        var_capacity = var_capacity ? var_capacity * 2 : 64;
+        vars = realloc(vars, sizeof(CVar) * var_capacity);
+    }
+    var = &vars[var_count++];
+    var->name = strdup(name);
+    var->initialized = false;
+    var->is_string = false;
+    var->has_local = false;
+    var->read = false;
+    var->text = NULL;
+    return var;
+}
+
+// holds an int value at run time (else it reads as 0)
+static bool IsIntVar(const CVar *var) {
+    return var && var->initialized && !var->is_string;
+}
+
+static void EmitExpression(FILE *out, Node *node) {
+    if(!node) {
+        fprintf(out, "0");
+        return;
+    }
+    switch(node->node_type) {
+        case 0: // NODE_NUM
+            if(node->int_val == INT32_MIN)
+                fprintf(out, "INT32_MIN");
+            else
+                fprintf(out, node->int_val < 0 ? "(%d)" : "%d", node->int_val);
+            return;
+        case 2: { // NODE_ID
+            CVar *var = FindVar(node->str_val);
+            if(IsIntVar(var)) {
+                fprintf(out, "v_%s", node->str_val);
+                var->read = true;
+            } else {
+                fprintf(out, "0");
+            }
+            return;
+        }
+        case 3: { // NODE_BINOP
+            const char *helper = NULL;
+            switch(node->binop.op) {
+                case '+': helper = "p0_add"; break;
+                case '-': helper = "p0_sub"; break;
+                case '*': helper = "p0_mul"; break;
+                case '/': helper = "p0_div"; break;
+                case '=':
+                    EmitExpression(out, node->binop.left);
+                    return;
+            }
+            if(!helper) {
+                fprintf(out, "0");
+                return;
+            }
+            fprintf(out, "%s(", helper);
+            EmitExpression(out, node->binop.left);
+            fprintf(out, ", ");
+            EmitExpression(out, node->binop.right);
+            fprintf(out, ")");
+            return;
+        }
+    }
+    fprintf(out, "0");
+}
+
+static void AppendPending(const char *s) {
+    size_t len = strlen(s);
+    pending = realloc(pending, pending_len + len + 1);
+    memcpy(pending + pending_len, s, len + 1);
+    pending_len += len;
+}
+
+// literal text gathered so far as one p0_str call (C string, split over lines)
+static void FlushPending(FILE *out) {
+    if(pending_len == 0)
+        return;
+    fprintf(out, "    p0_str(\"");
+    int column = 0;
+    for(size_t i = 0; i < pending_len; i++) {
+        unsigned char c = pending[i];
+        if(column >= LITERAL_LINE) {
+            fprintf(out, "\"\n           \"");
+            column = 0;
+        }
+        if(c == '"' || c == '\\')
+            column += fprintf(out, "\\%c", c);
+        else if(c == '\n')
+            column += fprintf(out, "\\n");
+        else if(c == '\t')
+            column += fprintf(out, "\\t");
+        else if(c < 0x20 || c >= 0x7F)
+            column += fprintf(out, "\\%03o", c); // always 3 digits: a digit may follow
+        else
+            column += fprintf(out, "%c", c);
+    }
+    fprintf(out, "\", %zu);\n", pending_len);
+    pending_len = 0;
+}
+
+// x = expr / x = "text" / x (decl w/o a value), as execute_statement does them
+static void EmitStore(FILE *out, Node *item, bool in_declaration) {
+    if(item->node_type == 3 && item->binop.op == '=') {
+        fprintf(out, "    v_%s = ", item->binop.left->str_val);
+        EmitExpression(out, item->binop.right);
+        fprintf(out, ";\n");
+        CVar *var = GetVar(item->binop.left->str_val);
+        var->initialized = true;
+        var->is_string = false;
+    } else if(item->node_type == NODE_STR_ASSIGN) {
+        CVar *var = GetVar(item->str_assign.id->str_val);
+        var->text = item->str_assign.str->str_val;
+        var->initialized = true;
+        var->is_string = true;
+    } else if(item->node_type == 2 && in_declaration) {
+        // reads as 0 again (still a ch var if it was one)
+        GetVar(item->str_val)->initialized = false;
+    }
+}
+
+static void EmitPrint(FILE *out, Node *node) {
+    Node *last_part = NULL;
+    for(Node *part = node->print_stmt.parts; part; part = part->list.next) {
+        last_part = part;
+        if(part->node_type != NODE_PRINT_PART)
+            continue;
+        Node *content = part->list.items;
+        if(content->node_type == 1) { // NODE_STR
+            AppendPending(content->str_val);
+        } else if(content->node_type == 2) { // NODE_ID
+            CVar *var = FindVar(content->str_val);
+            if(var && var->initialized && var->is_string) {
+                AppendPending(var->text);
+            } else if(IsIntVar(var)) {
+                FlushPending(out);
+                fprintf(out, "    p0_int(v_%s);\n", content->str_val);
+                var->read = true;
+            } else {
+                AppendPending("0");
+            }
+        } else {
+            FlushPending(out);
+            fprintf(out, "    p0_int(");
+            EmitExpression(out, content);
+            fprintf(out, ");\n");
+        }
+    }
+
+    // FIX 16: \n unless the line ends w/ a string literal or a ch var
+    if(last_part && last_part->node_type == NODE_PRINT_PART) {
+        Node *last = last_part->list.items;
+        if(last->node_type == 2) {
+            CVar *var = FindVar(last->str_val);
+            if(!var || !var->is_string)
+                AppendPending("\n");
+        } else if(last->node_type != 1) {
+            AppendPending("\n");
+        }
+    }
+}
+
+static void EmitStatement(FILE *out, Node *node) {
+    switch(node->node_type) {
+        case 4: // NODE_DECL
+        case 5: // NODE_ASSIGN
+            for(Node *item = node->list.items; item; item = item->list.next)
+                EmitStore(out, item, node->node_type == 4);
+            break;
+        case 6: // NODE_PRINT
+            EmitPrint(out, node);
+            break;
+    }
+}
+
+static void CFree() {
+    for(int i = 0; i < var_count; i++)
+        free(vars[i].name);
+    free(vars);
+    vars = NULL;
+    var_count = var_capacity = 0;
+    free(pending);
+    pending = NULL;
+    pending_len = 0;
+}
+
+bool GenerateCSource(Node *program, const char *filename) {
+    FILE *out = fopen(filename, "w");
+    if(!out)
+        return false;
+    CFree();
+
+    // every var that is ever assigned an int gets a local
+    for(Node *stmt = program; stmt; stmt = stmt->list.next) {
+        if(stmt->node_type != 4 && stmt->node_type != 5)
+            continue;
+        for(Node *item = stmt->list.items; item; item = item->list.next) {
+            if(item->node_type == 3 && item->binop.op == '=')
+                GetVar(item->binop.left->str_val)->has_local = true;
+        }
+    }
+
+    fprintf(out, "%s", prelude);
+    fprintf(out, "int main(void) {\n");
+    for(int i = 0; i < var_count; i++) {
+        if(vars[i].has_local)
+            fprintf(out, "    int32_t v_%s = 0;\n", vars[i].name);
+    }
+    fprintf(out, "\n");
+
+    for(Node *stmt = program; stmt; stmt = stmt->list.next)
+        EmitStatement(out, stmt);
+    FlushPending(out);
+    // keeps -Wall quiet about vars that are only ever stored
+    for(int i = 0; i < var_count; i++) {
+        if(vars[i].has_local && !vars[i].read)
+            fprintf(out, "    (void)v_%s;\n", vars[i].name);
+    }
+    fprintf(out, "    p0_flush();\n");
+    fprintf(out, "    return 0;\n");
+    fprintf(out, "}\n");
+
+    CFree();
+    bool ok = ferror(out) == 0;
+    return fclose(out) == 0 && ok;
+}
+
+// runs argv[0] (found on PATH) w/o a shell, so file names need no quoting;
+// its stdout goes to out when there is one; true if it exited w/ 0
+static bool RunCommand(char *const argv[], OutputCapture *out) {
+    int fds[2];
+    if(out && pipe(fds) != 0)
+        return false;
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0) {
+        if(out) {
+            dup2(fds[1], STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+        }
+        execvp(argv[0], argv);
+        fprintf(stderr, "Error: cannot run %s\n", argv[0]);
+        _exit(127);
+    }
+    if(out) {
+        close(fds[1]);
+        char buffer[4096];
+        ssize_t n;
+        while(pid > 0 && (n = read(fds[0], buffer, sizeof(buffer) - 1)) > 0) {
+            buffer[n] = '\0';
+            capture_write(out, buffer);
+        }
+        close(fds[0]);
+    }
+    int status;
+    if(pid < 0 || waitpid(pid, &status, 0) != pid)
+        return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+bool CompileAndRunCSource(const char *filename, OutputCapture *out) {
+    // executable: the file name w/o .c
+    size_t len = strlen(filename);
+    char *exe = malloc(len + 7);
+    if(len > 2 && strcmp(filename + len - 2, ".c") == 0)
+        sprintf(exe, "%s%.*s", strchr(filename, '/') ? "" : "./", (int)(len - 2), filename);
+    else
+        sprintf(exe, "%s%s.out", strchr(filename, '/') ? "" : "./", filename);
+
+    char *gcc[] = { "gcc", "-O2", "-o", exe, (char*)filename, NULL };
+    if(!RunCommand(gcc, NULL)) {
+        fprintf(stderr, "Error: gcc failed on %s\n", filename);
+        free(exe);
+        return false;
+    }
+    char *run[] = { exe, NULL };
+    bool ok = RunCommand(run, out);
+    if(!ok)
+        fprintf(stderr, "Error: %s failed\n", exe);
+    free(exe);
+    return ok;
+}
\ No newline at end of file
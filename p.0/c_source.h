@@ -0,0 +1,22 @@
+#ifndef C_SOURCE_H
+#define C_SOURCE_H
+
+#include <stdbool.h>
+#include "ast.h"
+#include "output.h"
+
+// --emit=c: the checked AST as one C translation unit, for the host C
+// compiler to optimise
+//   one int32_t local per int var, wrapping arithmetic, x / 0 is 0 (same
+//   as interpreter.c)
+//   prints go through a buffered fwrite writer
+// set / ch state of the vars is tracked at compile time (straight-line
+// code), so ch text and unset vars are constants in the C
+// false if the file can't be written
+bool GenerateCSource(Node *program, const char *filename);
+
+// --cc: gcc -O2 the file into an executable next to it and run that,
+// its stdout into out; false if it could not be built or did not exit 0
+bool CompileAndRunCSource(const char *filename, OutputCapture *out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "constants.h"
+#include "symbol_table.h"
+
+// a pool load is one instruction plus the load-use latency (ld = 2 in the
+// default latency model), so it only wins over builds of 3+ instructions
+#define COST_POOL_LOAD 2
+
+// longest build: lui, ori, dsll, ori, dsll, ori
+#define MAX_BUILD 8
+
+typedef struct {
+    Instruction ins[MAX_BUILD];
+    int count;
+} Build;
+
+// constant pool: one .dword slot per distinct value
+static int64_t *pool_value = NULL;
+static int *pool_sym = NULL;
+static int pool_count = 0;
+static int pool_capacity = 0;
+
+// per register: constant it is known to hold at this point of the program
+static bool known[32];
+static int64_t known_value[32];
+
+static bool Fits16(int64_t v) {
+    return v >= INT16_MIN && v <= INT16_MAX;
+}
+
+static bool Fits32(int64_t v) {
+    return v >= INT32_MIN && v <= INT32_MAX;
+}
+
+static void Add(Build *b, Opcode op, int rd, int rs, int64_t imm) {
+    Instruction ins = { .op = op, .rd = rd, .rs = rs, .rt = 0, .sym = -1, .imm = imm };
+    b->ins[b->count++] = ins;
+}
+
+// rd = v, v in int32 (lui sign-extends, ori fills in the low half)
+static void BuildInt32(Build *b, int rd, int64_t v) {
+    if(Fits16(v)) {
+        Add(b, OPC_DADDIU, rd, 0, v);
+    } else if(v >= 0 && v <= 0xFFFF) {
+        Add(b, OPC_ORI, rd, 0, v);
+    } else {
+        Add(b, OPC_LUI, rd, 0, (v >> 16) & 0xFFFF);
+        if(v & 0xFFFF)
+            Add(b, OPC_ORI, rd, rd, v & 0xFFFF);
+    }
+}
+
+// rd <<= amount (dsll takes 0..31, dsll32 the rest)
+static void AddShift(Build *b, int rd, int amount) {
+    if(amount >= 32)
+        Add(b, OPC_DSLL32, rd, rd, amount - 32);
+    else
+        Add(b, OPC_DSLL, rd, rd, amount);
+}
+
+// the top bits (v >> 16*halves, must fit int32) as an int32, then each of
+// the low halfwords shifted in and or-ed on (zero ones are only shifted)
+static void BuildHalfwords(Build *b, int rd, int64_t v, int halves) {
+    BuildInt32(b, rd, v >> (16 * halves));
+    int pending = 0;
+    for(int half = halves - 1; half >= 0; half--) {
+        pending += 16;
+        int64_t bits = (v >> (16 * half)) & 0xFFFF;
+        if(bits) {
+            AddShift(b, rd, pending);
+            Add(b, OPC_ORI, rd, rd, bits);
+            pending = 0;
+        }
+    }
+    if(pending)
+        AddShift(b, rd, pending);
+}
+
+static void Keep(Build *best, const Build *b) {
+    if(b->count < best->count)
+        *best = *b;
+}
+
+// shortest instruction sequence leaving v in rd
+static Build CheapestBuild(int rd, int64_t v) {
+    Build best = { .count = MAX_BUILD + 1 };
+    Build b;
+
+    // next to a constant some register alr holds (daddiu wraps, so
+    // the distance is taken mod 2^64 too)
+    for(int r = 1; r < 32 && best.count > 1; r++) {
+        int64_t distance = (int64_t)((uint64_t)v - (uint64_t)known_value[r]);
+        if(known[r] && Fits16(distance)) {
+            b.count = 0;
+            Add(&b, OPC_DADDIU, rd, r, distance);
+            Keep(&best, &b);
+        }
+    }
+
+    for(int halves = 0; halves <= 3; halves++) {
+        if(Fits32(v >> (16 * halves))) {
+            b.count = 0;
+            BuildHalfwords(&b, rd, v, halves);
+            Keep(&best, &b);
+        }
+    }
+
+    // small constant w/ trailing zeros: build it, then one shift
+    int shift = __builtin_ctzll((uint64_t)v);
+    if(shift > 0 && Fits32(v >> shift)) {
+        b.count = 0;
+        BuildInt32(&b, rd, v >> shift);
+        AddShift(&b, rd, shift);
+        Keep(&best, &b);
+    }
+    return best;
+}
+
+// symbol id of the pool slot holding v
+static int PoolSymbol(int64_t v) {
+    for(int i = 0; i < pool_count; i++) {
+        if(pool_value[i] == v)
+            return pool_sym[i];
+    }
+    if(pool_count >= pool_capacity) {
+        pool_capacity = pool_capacity ? pool_capacity * 2 : 16;
+        pool_value = realloc(pool_value, sizeof(int64_t) * pool_capacity);
+        pool_sym = realloc(pool_sym, sizeof(int) * pool_capacity);
+    }
+    char name[32];
+    sprintf(name, "_const%d", pool_count);
+    pool_value[pool_count] = v;
+    pool_sym[pool_count] = AddDataConstant(name, v);
+    return pool_sym[pool_count++];
+}
+
+static void Forget(int reg) {
+    if(reg != 0)
+        known[reg] = false;
+}
+
+static void Learn(int reg, int64_t v) {
+    if(reg != 0) {
+        known[reg] = true;
+        known_value[reg] = v;
+    }
+}
+
+// value of rs if known (r0 always is)
+static bool KnownSource(int rs, int64_t *v) {
+    *v = rs == 0 ? 0 : known_value[rs];
+    return rs == 0 || known[rs];
+}
+
+// follow the effect of ins on the known constants (straight-line code;
+// anything that jumps or is jumped to forgets them all)
+static void Track(const Instruction *ins) {
+    int64_t v;
+    switch(ins->op) {
+        case OPC_LABEL:
+        case OPC_JAL:
+        case OPC_JR:
+        case OPC_J:
+        case OPC_BEQ:
+        case OPC_BNE:
+        case OPC_HALT:
+            memset(known, 0, sizeof(known));
+            break;
+        case OPC_DADDIU:
+            if(ins->sym < 0 && KnownSource(ins->rs, &v))
+                Learn(ins->rd, (int64_t)((uint64_t)v + (uint64_t)ins->imm));
+            else
+                Forget(ins->rd);
+            break;
+        case OPC_ORI:
+            if(KnownSource(ins->rs, &v))
+                Learn(ins->rd, v | ins->imm);
+            else
+                Forget(ins->rd);
+            break;
+        case OPC_LUI:
+            Learn(ins->rd, (int64_t)(int32_t)((uint32_t)ins->imm << 16));
+            break;
+        case OPC_DSLL:
+        case OPC_DSLL32:
+            if(KnownSource(ins->rs, &v))
+                Learn(ins->rd, (int64_t)((uint64_t)v << (ins->imm + (ins->op == OPC_DSLL32 ? 32 : 0))));
+            else
+                Forget(ins->rd);
+            break;
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_MFLO:
+        case OPC_MFHI:
+        case OPC_LD:
+        case OPC_LBU:
+        case OPC_SLT:
+        case OPC_DSRA:
+            Forget(ins->rd);
+            break;
+        default:
+            break; // stores, syscall, dmult/ddiv write no register
+    }
+}
+
+void MaterializeConstants(InstrBuffer *code) {
+    memset(known, 0, sizeof(known));
+    pool_count = 0;
+    InstrBuffer out = { 0 };
+    for(int i = 0; i < code->count; i++) {
+        Instruction ins = code->code[i];
+        bool wide = ins.op == OPC_DADDIU && ins.rs == 0 && ins.sym < 0 && !Fits16(ins.imm);
+        if(!wide || ins.rd == 0) {
+            InstrAppend(&out, ins);
+            Track(&ins);
+            continue;
+        }
+
+        int64_t v = ins.imm;
+        Build b = CheapestBuild(ins.rd, v);
+        if(COST_POOL_LOAD < b.count) {
+            Instruction load = { .op = OPC_LD, .rd = ins.rd, .rs = 0, .rt = 0, .sym = PoolSymbol(v), .imm = 0,
+                                 .line = ins.line, .column = ins.column };
+            InstrAppend(&out, load);
+            Learn(ins.rd, v);
+            continue;
+        }
+        for(int k = 0; k < b.count; k++) {
+            b.ins[k].line = ins.line; // the build stands for ins in the source
+            b.ins[k].column = ins.column;
+            InstrAppend(&out, b.ins[k]);
+            Track(&b.ins[k]);
+        }
+    }
+    InstrBufferFree(code);
+    *code = out;
+}
\ No newline at end of file
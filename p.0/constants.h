@@ -0,0 +1,18 @@
+#ifndef CONSTANTS_H
+#define CONSTANTS_H
+
+#include "instruction.h"
+
+// codegen loads every constant as daddiu rd, r0, #k whatever its size;
+// this rewrites the ones daddiu can't encode (k outside int16) into the
+// cheapest sequence that builds k:
+//   ori                    0..0xFFFF
+//   daddiu rd, rX, #d      rX alr holds a constant within int16 of k
+//   lui (+ ori)            int32
+//   any of these + dsll    k w/ trailing zero bits
+//   lui/ori/dsll/ori...    any 64-bit value
+//   ld from _constN        when that is cheaper (pool is de-duplicated)
+// call b4 LayoutData (the pool lives in .data)
+void MaterializeConstants(InstrBuffer *code);
+
+#endif
\ No newline at end of file
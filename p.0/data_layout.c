@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "data_layout.h"
+#include "symbol_table.h"
+
+// r28 points here: offsets -32768..32767 from it cover the 64K right
+// after what r0 reaches
+#define DATA_BASE 0x10000
+
+// address temp for a far sd (runtime scratch: generated code never keeps
+// a value in it and the runtime routines don't store to symbols)
+#define REG_FAR_ADDRESS 2
+
+#define REACH_R0 0
+#define REACH_BASE 1
+#define REACH_FAR 2
+
+static bool FitsOffset(int64_t v) {
+    return v >= INT16_MIN && v <= INT16_MAX;
+}
+
+static int Reach(int64_t offset) {
+    if(FitsOffset(offset))
+        return REACH_R0;
+    if(FitsOffset(offset - DATA_BASE))
+        return REACH_BASE;
+    return REACH_FAR;
+}
+
+// (source position of the instruction it is built for, if any)
+static void Add(InstrBuffer *buf, Opcode op, int rd, int rs, long long imm, const Instruction *from) {
+    Instruction ins = { .op = op, .rd = rd, .rs = rs, .rt = 0, .sym = -1, .imm = imm };
+    if(from) {
+        ins.line = from->line;
+        ins.column = from->column;
+    }
+    InstrAppend(buf, ins);
+}
+
+// lui/ori of an address into reg (lui sign-extends, .data stays below 2G)
+static void AddAddress(InstrBuffer *buf, int reg, uint64_t address, const Instruction *from) {
+    Add(buf, OPC_LUI, reg, 0, (address >> 16) & 0xFFFF, from);
+    if(address & 0xFFFF)
+        Add(buf, OPC_ORI, reg, reg, address & 0xFFFF, from);
+}
+
+void LayoutData(InstrBuffer *code) {
+    uint64_t *uses = calloc(SymbolCount() + 1, sizeof(uint64_t));
+    for(int i = 0; i < code->count; i++) {
+        if(code->code[i].sym >= 0)
+            uses[code->code[i].sym]++;
+    }
+    uint64_t size = LayoutDataSection(uses);
+    free(uses);
+    if(size <= (uint64_t)INT16_MAX + 1)
+        return; // every symbol starts within reach of r0
+
+    bool base_used = false;
+    for(int i = 0; i < code->count && !base_used; i++) {
+        const Instruction *ins = &code->code[i];
+        base_used = ins->sym >= 0 && Reach(GetOffsetOfSymbolId(ins->sym)) == REACH_BASE;
+    }
+
+    InstrBuffer far = { 0 };
+    if(base_used)
+        AddAddress(&far, REG_DATA_BASE, DATA_BASE, NULL);
+    for(int i = 0; i < code->count; i++) {
+        Instruction ins = code->code[i];
+        if(ins.sym < 0 || ins.rs != 0) {
+            InstrAppend(&far, ins);
+            continue;
+        }
+        int64_t offset = GetOffsetOfSymbolId(ins.sym);
+        switch(Reach(offset)) {
+            case REACH_R0:
+                break;
+            case REACH_BASE:
+                ins.rs = REG_DATA_BASE;
+                ins.sym = -1;
+                ins.imm = offset - DATA_BASE;
+                break;
+            case REACH_FAR: {
+                // build the address in the destination (scratch for sd)
+                int reg = ins.op == OPC_SD ? REG_FAR_ADDRESS : ins.rd;
+                AddAddress(&far, reg, offset, &ins);
+                if(ins.op == OPC_DADDIU)
+                    continue; // the address was the result
+                ins.rs = reg;
+                ins.sym = -1;
+                ins.imm = 0;
+                break;
+            }
+        }
+        InstrAppend(&far, ins);
+    }
+    InstrBufferFree(code);
+    *code = far;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef DATA_LAYOUT_H
+#define DATA_LAYOUT_H
+
+#include "instruction.h"
+
+// base register for .data past the 16-bit reach of r0
+#define REG_DATA_BASE 28
+
+// final .data layout for the lowered program: slots packed hot first, then
+// every symbol operand rewritten so its offset is reachable:
+//   offset < 32K            sym(r0) as before
+//   within 32K of the base  offset(r28), r28 set up once w/ lui/ori
+//   beyond that             address built w/ lui/ori right b4 the access
+// call once the code is final (after outlining and the runtime routines)
+void LayoutData(InstrBuffer *code);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include "disassembler.h"
+#include "instruction.h"
+
+// growable text
+typedef struct {
+    char *text;
+    size_t len;
+    size_t capacity;
+} TextBuffer;
+
+static void Appendf(TextBuffer *buf, const char *format, ...) {
+    for(;;) {
+        va_list args;
+        va_start(args, format);
+        size_t room = buf->capacity - buf->len;
+        int n = vsnprintf(buf->text ? buf->text + buf->len : NULL, room, format, args);
+        va_end(args);
+        if(n >= 0 && (size_t)n < room) {
+            buf->len += n;
+            return;
+        }
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        if(n >= 0 && buf->capacity < buf->len + n + 1)
+            buf->capacity = buf->len + n + 1;
+        buf->text = realloc(buf->text, buf->capacity);
+    }
+}
+
+// Opcode + 1 by funct (R-type) and by primary opcode (I/J), 0 if none
+// (the inverse of instr_info)
+static const uint8_t funct_op[64] = {
+    [FUNCT_DADDU] = OPC_DADDU + 1,
+    [FUNCT_DSUBU] = OPC_DSUBU + 1,
+    [FUNCT_DMULT] = OPC_DMULT + 1,
+    [FUNCT_DDIV] = OPC_DDIV + 1,
+    [FUNCT_MFHI] = OPC_MFHI + 1,
+    [FUNCT_MFLO] = OPC_MFLO + 1,
+    [FUNCT_SYSCALL] = OPC_SYSCALL + 1,
+    [FUNCT_JR] = OPC_JR + 1,
+    [FUNCT_SLT] = OPC_SLT + 1,
+    [FUNCT_DSLL] = OPC_DSLL + 1,
+    [FUNCT_DSRA] = OPC_DSRA + 1,
+    [FUNCT_DSLL32] = OPC_DSLL32 + 1,
+};
+
+static const uint8_t opcode_op[64] = {
+    [OP_DADDIU] = OPC_DADDIU + 1,
+    [OP_LD] = OPC_LD + 1,
+    [OP_SD] = OPC_SD + 1,
+    [OP_LBU] = OPC_LBU + 1,
+    [OP_SB] = OPC_SB + 1,
+    [OP_BEQ] = OPC_BEQ + 1,
+    [OP_BNE] = OPC_BNE + 1,
+    [OP_LUI] = OPC_LUI + 1,
+    [OP_ORI] = OPC_ORI + 1,
+    [OP_J] = OPC_J + 1,
+    [OP_JAL] = OPC_JAL + 1,
+};
+
+bool DecodeWord(uint32_t word, int64_t pc, Instruction *ins) {
+    Instruction decoded = { .sym = -1 };
+    *ins = decoded;
+    if(word == CODE_HALT) {
+        ins->op = OPC_HALT;
+        return true;
+    }
+
+    int opcode = word >> 26;
+    int rs = (word >> 21) & 31;
+    int rt = (word >> 16) & 31;
+    int rd = (word >> 11) & 31;
+    int shamt = (word >> 6) & 31;
+    int funct = word & 63;
+    int op;
+    if(opcode == 0) {
+        op = funct_op[funct] - 1;
+        if(op < 0)
+            return false;
+        ins->op = op;
+        // fields the encoder leaves 0 must be 0 (else another word would
+        // read back as the same instruction)
+        switch(op) {
+            case OPC_DADDU:
+            case OPC_DSUBU:
+            case OPC_SLT:
+                ins->rd = rd;
+                ins->rs = rs;
+                ins->rt = rt;
+                return shamt == 0;
+            case OPC_DMULT:
+            case OPC_DDIV:
+                ins->rs = rs;
+                ins->rt = rt;
+                return rd == 0 && shamt == 0;
+            case OPC_MFLO:
+            case OPC_MFHI:
+                ins->rd = rd;
+                return rs == 0 && rt == 0 && shamt == 0;
+            case OPC_SYSCALL:
+                ins->imm = shamt;
+                return rs == 0 && rt == 0 && rd == 0;
+            case OPC_JR:
+                ins->rs = rs;
+                return rt == 0 && rd == 0 && shamt == 0;
+            case OPC_DSLL:
+            case OPC_DSRA:
+            case OPC_DSLL32:
+                ins->rd = rd;
+                ins->rs = rt; // shifts take their source in the rt field
+                ins->imm = shamt;
+                return rs == 0;
+        }
+        return false;
+    }
+
+    op = opcode_op[opcode] - 1;
+    if(op < 0)
+        return false;
+    ins->op = op;
+    if(instr_info[op].format == FMT_J) {
+        ins->imm = word & 0x3FFFFFF;
+        return true;
+    }
+    int16_t imm = (int16_t)(word & 0xFFFF);
+    switch(op) {
+        case OPC_BEQ:
+        case OPC_BNE:
+            ins->rs = rs;
+            ins->rt = rt;
+            ins->imm = pc + 1 + imm;
+            return true;
+        case OPC_LUI:
+            ins->rd = rt;
+            ins->imm = word & 0xFFFF;
+            return rs == 0;
+        case OPC_ORI:
+            ins->rd = rt;
+            ins->rs = rs;
+            ins->imm = word & 0xFFFF;
+            return true;
+        default: // daddiu and the loads/stores: rt is the register written/stored
+            ins->rd = rt;
+            ins->rs = rs;
+            ins->imm = imm;
+            return true;
+    }
+}
+
+// one decoded instruction, in PrintInstruction's syntax
+static void AppendInstruction(TextBuffer *buf, const Instruction *ins) {
+    const char *name = instr_info[ins->op].mnemonic;
+    long long imm = ins->imm;
+    switch(ins->op) {
+        case OPC_DADDIU:
+        case OPC_DSLL:
+        case OPC_DSRA:
+        case OPC_DSLL32:
+        case OPC_ORI:
+            Appendf(buf, "%s r%d, r%d, #%lld\n", name, ins->rd, ins->rs, imm);
+            break;
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_SLT:
+            Appendf(buf, "%s r%d, r%d, r%d\n", name, ins->rd, ins->rs, ins->rt);
+            break;
+        case OPC_DMULT:
+        case OPC_DDIV:
+            Appendf(buf, "%s r%d, r%d\n", name, ins->rs, ins->rt);
+            break;
+        case OPC_MFLO:
+        case OPC_MFHI:
+            Appendf(buf, "%s r%d\n", name, ins->rd);
+            break;
+        case OPC_LD:
+        case OPC_SD:
+        case OPC_LBU:
+        case OPC_SB:
+            Appendf(buf, "%s r%d, %lld(r%d)\n", name, ins->rd, imm, ins->rs);
+            break;
+        case OPC_LUI:
+            Appendf(buf, "%s r%d, #%lld\n", name, ins->rd, imm);
+            break;
+        case OPC_BEQ:
+        case OPC_BNE:
+            Appendf(buf, "%s r%d, r%d, L%lld\n", name, ins->rs, ins->rt, imm);
+            break;
+        case OPC_SYSCALL:
+            Appendf(buf, "%s %lld\n", name, imm);
+            break;
+        case OPC_JAL:
+        case OPC_J:
+            Appendf(buf, "%s L%lld\n", name, imm);
+            break;
+        case OPC_JR:
+            Appendf(buf, "%s r%d\n", name, ins->rs);
+            break;
+        case OPC_HALT:
+            Appendf(buf, "%s\n", name);
+            break;
+    }
+}
+
+static bool IsJump(const Instruction *ins) {
+    return ins->op == OPC_JAL || ins->op == OPC_J || ins->op == OPC_BEQ || ins->op == OPC_BNE;
+}
+
+bool DisassembleWords(const uint32_t *words, int64_t count, char **text, size_t *len) {
+    TextBuffer buf = { 0 };
+    bool ok = true;
+
+    // jump/branch targets get a label (a target past the end can't have one)
+    bool *target = calloc(count + 1, sizeof(bool));
+    for(int64_t pc = 0; pc < count; pc++) {
+        Instruction ins;
+        if(DecodeWord(words[pc], pc, &ins) && IsJump(&ins) && ins.imm >= 0 && ins.imm <= count)
+            target[ins.imm] = true;
+    }
+
+    Appendf(&buf, ".code\n");
+    for(int64_t pc = 0; pc < count; pc++) {
+        if(target[pc])
+            Appendf(&buf, "L%lld:\n", (long long)pc);
+        Instruction ins;
+        if(!DecodeWord(words[pc], pc, &ins)) {
+            Appendf(&buf, "; %lld: %08X is not an instruction\n", (long long)pc, words[pc]);
+            ok = false;
+        } else if(IsJump(&ins) && (ins.imm < 0 || ins.imm > count)) {
+            Appendf(&buf, "; %lld: %08X jumps outside the code\n", (long long)pc, words[pc]);
+            ok = false;
+        } else {
+            AppendInstruction(&buf, &ins);
+        }
+    }
+    if(target[count])
+        Appendf(&buf, "L%lld:\n", (long long)count);
+    free(target);
+
+    *text = buf.text;
+    *len = buf.len;
+    return ok;
+}
+
+static void AppendWord(uint32_t **words, int64_t *count, int64_t *capacity, uint32_t word) {
+    if(*count >= *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        *words = realloc(*words, sizeof(uint32_t) * *capacity);
+    }
+    (*words)[(*count)++] = word;
+}
+
+bool ReadMachineFile(const char *filename, bool raw, uint32_t **words, int64_t *count) {
+    *words = NULL;
+    *count = 0;
+    FILE *in = fopen(filename, raw ? "rb" : "r");
+    if(!in) {
+        fprintf(stderr, "Error: Cannot open machine code file %s\n", filename);
+        return false;
+    }
+    int64_t capacity = 0;
+    bool ok = true;
+    if(raw) {
+        unsigned char b[4];
+        size_t got;
+        while((got = fread(b, 1, 4, in)) == 4)
+            AppendWord(words, count, &capacity, (uint32_t)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3]);
+        if(got != 0) {
+            fprintf(stderr, "Error: %s is not a whole number of words\n", filename);
+            ok = false;
+        }
+    } else {
+        // "<32 bits in groups of 4> : XXXXXXXX", the hex column is the word
+        char line[256];
+        int line_number = 0;
+        while(fgets(line, sizeof(line), in)) {
+            line_number++;
+            char *colon = strrchr(line, ':');
+            char *end;
+            unsigned long word = colon ? strtoul(colon + 1, &end, 16) : 0;
+            if(!colon || end == colon + 1) {
+                if(strspn(line, " \t\r\n") == strlen(line))
+                    continue; // blank
+                fprintf(stderr, "%s:%d: no hex word\n", filename, line_number);
+                ok = false;
+                continue;
+            }
+            AppendWord(words, count, &capacity, (uint32_t)word);
+        }
+    }
+    fclose(in);
+    return ok;
+}
\ No newline at end of file
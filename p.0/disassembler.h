@@ -0,0 +1,26 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "instruction.h"
+
+// .mc words back to MIPS64 assembly, through the same instr_info table
+// the encoder uses (opcode / funct -> Opcode)
+// the text is canonical and p0as reads it back: numeric .data offsets
+// (the symbol names are not in the words), code labels L<index>
+
+// word at index pc -> ins (jal/j/branch imm: target index, I-type .data
+// operands: the offset, sym -1); false if no instruction encodes to it
+bool DecodeWord(uint32_t word, int64_t pc, Instruction *ins);
+
+// .code section for the words, w/ L<n>: before every jump/branch target
+// (malloc'd, length in *len); false if some word did not decode (it is
+// left in the text as a ; comment)
+bool DisassembleWords(const uint32_t *words, int64_t count, char **text, size_t *len);
+
+// words of a .mc file (the hex column), or of a raw big-endian image
+bool ReadMachineFile(const char *filename, bool raw, uint32_t **words, int64_t *count);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "instruction.h"
+#include "symbol_table.h"
+
+const InstrInfo instr_info[OPC_COUNT] = {
+    [OPC_DADDIU]  = { "daddiu",  FMT_I,    OP_DADDIU, 0 },
+    [OPC_DADDU]   = { "daddu",   FMT_R,    0,         FUNCT_DADDU },
+    [OPC_DSUBU]   = { "dsubu",   FMT_R,    0,         FUNCT_DSUBU },
+    [OPC_DMULT]   = { "dmult",   FMT_R,    0,         FUNCT_DMULT },
+    [OPC_DDIV]    = { "ddiv",    FMT_R,    0,         FUNCT_DDIV },
+    [OPC_MFLO]    = { "mflo",    FMT_R,    0,         FUNCT_MFLO },
+    [OPC_MFHI]    = { "mfhi",    FMT_R,    0,         FUNCT_MFHI },
+    [OPC_LD]      = { "ld",      FMT_I,    OP_LD,     0 },
+    [OPC_SD]      = { "sd",      FMT_I,    OP_SD,     0 },
+    [OPC_SYSCALL] = { "syscall", FMT_R,    0,         FUNCT_SYSCALL },
+    [OPC_JAL]     = { "jal",     FMT_J,    OP_JAL,    0 },
+    [OPC_JR]      = { "jr",      FMT_R,    0,         FUNCT_JR },
+    [OPC_HALT]    = { "halt",    FMT_RAW,  0,         0 },
+    [OPC_LABEL]   = { "",        FMT_NONE, 0,         0 },
+    [OPC_LBU]     = { "lbu",     FMT_I,    OP_LBU,    0 },
+    [OPC_SB]      = { "sb",      FMT_I,    OP_SB,     0 },
+    [OPC_SLT]     = { "slt",     FMT_R,    0,         FUNCT_SLT },
+    [OPC_DSLL]    = { "dsll",    FMT_R,    0,         FUNCT_DSLL },
+    [OPC_DSRA]    = { "dsra",    FMT_R,    0,         FUNCT_DSRA },
+    [OPC_BEQ]     = { "beq",     FMT_I,    OP_BEQ,    0 },
+    [OPC_BNE]     = { "bne",     FMT_I,    OP_BNE,    0 },
+    [OPC_J]       = { "j",       FMT_J,    OP_J,      0 },
+    [OPC_LUI]     = { "lui",     FMT_I,    OP_LUI,    0 },
+    [OPC_ORI]     = { "ori",     FMT_I,    OP_ORI,    0 },
+    [OPC_DSLL32]  = { "dsll32",  FMT_R,    0,         FUNCT_DSLL32 },
+};
+
+static char **code_labels = NULL;
+static int code_label_count = 0;
+static int code_label_capacity = 0;
+
+int NewCodeLabel(const char *name) {
+    if(code_label_count >= code_label_capacity) {
+        code_label_capacity = code_label_capacity ? code_label_capacity * 2 : 16;
+        code_labels = realloc(code_labels, sizeof(char*) * code_label_capacity);
+    }
+    code_labels[code_label_count] = strdup(name);
+    return code_label_count++;
+}
+
+const char* CodeLabelName(int id) {
+    return (id >= 0 && id < code_label_count) ? code_labels[id] : "?";
+}
+
+void CodeLabelsReset() {
+    for(int i = 0; i < code_label_count; i++)
+        free(code_labels[i]);
+    code_label_count = 0;
+}
+
+void InstrAppend(InstrBuffer *buf, Instruction ins) {
+    if(buf->count >= buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 256;
+        buf->code = realloc(buf->code, sizeof(Instruction) * buf->capacity);
+    }
+    buf->code[buf->count++] = ins;
+}
+
+void InstrBufferFree(InstrBuffer *buf) {
+    free(buf->code);
+    buf->code = NULL;
+    buf->count = buf->capacity = 0;
+}
+
+// same instruction (the source position is not part of it)
+bool InstructionEqual(const Instruction *a, const Instruction *b) {
+    return a->op == b->op && a->rd == b->rd && a->rs == b->rs && a->rt == b->rt &&
+           a->sym == b->sym && a->imm == b->imm;
+}
+
+// FNV-1a over the fields (not the struct bytes: padding)
+uint64_t InstructionHash(const Instruction *ins) {
+    uint64_t fields[6] = { ins->op, ins->rd, ins->rs, ins->rt, (uint64_t)(int64_t)ins->sym, (uint64_t)ins->imm };
+    uint64_t h = 1469598103934665603ULL;
+    for(int i = 0; i < 6; i++) {
+        h ^= fields[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void PrintInstruction(const Instruction *ins, FILE *out) {
+    const char *name = instr_info[ins->op].mnemonic;
+    switch(ins->op) {
+        case OPC_DADDIU:
+            if(ins->sym >= 0)
+                fprintf(out, "%s r%d, r%d, %s\n", name, ins->rd, ins->rs, GetSymbolName(ins->sym));
+            else
+                fprintf(out, "%s r%d, r%d, #%lld\n", name, ins->rd, ins->rs, (long long)ins->imm);
+            break;
+        case OPC_DADDU:
+        case OPC_DSUBU:
+            fprintf(out, "%s r%d, r%d, r%d\n", name, ins->rd, ins->rs, ins->rt);
+            break;
+        case OPC_DMULT:
+        case OPC_DDIV:
+            fprintf(out, "%s r%d, r%d\n", name, ins->rs, ins->rt);
+            break;
+        case OPC_MFLO:
+        case OPC_MFHI:
+            fprintf(out, "%s r%d\n", name, ins->rd);
+            break;
+        case OPC_LD:
+        case OPC_SD:
+        case OPC_LBU:
+        case OPC_SB:
+            if(ins->sym >= 0)
+                fprintf(out, "%s r%d, %s(r%d)\n", name, ins->rd, GetSymbolName(ins->sym), ins->rs);
+            else
+                fprintf(out, "%s r%d, %lld(r%d)\n", name, ins->rd, (long long)ins->imm, ins->rs);
+            break;
+        case OPC_SLT:
+            fprintf(out, "%s r%d, r%d, r%d\n", name, ins->rd, ins->rs, ins->rt);
+            break;
+        case OPC_DSLL:
+        case OPC_DSRA:
+        case OPC_DSLL32:
+        case OPC_ORI:
+            fprintf(out, "%s r%d, r%d, #%lld\n", name, ins->rd, ins->rs, (long long)ins->imm);
+            break;
+        case OPC_LUI:
+            fprintf(out, "%s r%d, #%lld\n", name, ins->rd, (long long)ins->imm);
+            break;
+        case OPC_BEQ:
+        case OPC_BNE:
+            fprintf(out, "%s r%d, r%d, %s\n", name, ins->rs, ins->rt, CodeLabelName(ins->imm));
+            break;
+        case OPC_SYSCALL:
+            fprintf(out, "%s %lld\n", name, (long long)ins->imm);
+            break;
+        case OPC_JAL:
+        case OPC_J:
+            fprintf(out, "%s %s\n", name, CodeLabelName(ins->imm));
+            break;
+        case OPC_JR:
+            fprintf(out, "%s r%d\n", name, ins->rs);
+            break;
+        case OPC_HALT:
+            fprintf(out, "%s\n", name);
+            break;
+        case OPC_LABEL:
+            fprintf(out, "%s:\n", CodeLabelName(ins->imm));
+            break;
+    }
+}
\ No newline at end of file
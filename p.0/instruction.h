@@ -0,0 +1,123 @@
+#ifndef INSTRUCTION_H
+#define INSTRUCTION_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// in-memory instruction IR
+// codegen builds an array of these; the encoder (machine_code.c) turns it
+// straight into 32-bit words and the .s file is only a printed view of it
+
+typedef enum {
+    OPC_DADDIU, // daddiu rd, rs, #imm | daddiu rd, rs, sym (address of sym)
+    OPC_DADDU, // daddu rd, rs, rt
+    OPC_DSUBU, // dsubu rd, rs, rt
+    OPC_DMULT, // dmult rs, rt
+    OPC_DDIV, // ddiv rs, rt
+    OPC_MFLO, // mflo rd
+    OPC_MFHI, // mfhi rd
+    OPC_LD, // ld rd, sym(rs) | ld rd, imm(rs) w/o sym
+    OPC_SD, // sd rd, sym(rs)  (rd is the value stored)
+    OPC_SYSCALL, // syscall imm
+    OPC_JAL, // jal <code label imm>
+    OPC_JR, // jr rs
+    OPC_HALT, // halt
+    OPC_LABEL, // <code label imm>: (not an instruction)
+    // used by the runtime support routines (runtime.c)
+    OPC_LBU, // lbu rd, imm(rs)
+    OPC_SB, // sb rd, imm(rs)
+    OPC_SLT, // slt rd, rs, rt
+    OPC_DSLL, // dsll rd, rs, #imm
+    OPC_DSRA, // dsra rd, rs, #imm
+    OPC_BEQ, // beq rs, rt, <code label imm>
+    OPC_BNE, // bne rs, rt, <code label imm>
+    OPC_J, // j <code label imm>
+    // far .data addressing (data_layout.c)
+    OPC_LUI, // lui rd, #imm  (rd = imm << 16)
+    OPC_ORI, // ori rd, rs, #imm  (zero-extended imm)
+    OPC_DSLL32, // dsll32 rd, rs, #imm  (shift by imm + 32, constants.c)
+    OPC_COUNT
+} Opcode;
+
+// instruction formats
+#define FMT_R 0
+#define FMT_I 1
+#define FMT_J 2
+#define FMT_RAW 3 // fixed word (halt)
+#define FMT_NONE 4 // labels
+
+// I-type opcodes
+#define OP_DADDIU 0x19 // daddiu rt, rs, immediate
+#define OP_LD 0x37 // 64-bit load doubleword
+#define OP_SD 0x3F // 64-bit store doubleword
+#define OP_LBU 0x24
+#define OP_SB 0x28
+#define OP_BEQ 0x04 // offset = target - (pc + 1), in instructions
+#define OP_BNE 0x05
+#define OP_LUI 0x0F
+#define OP_ORI 0x0D
+
+// J-type opcodes
+#define OP_J 0x02
+#define OP_JAL 0x03 // jal target (target = instruction index in .code)
+
+// R-type function codes (funct field)
+#define FUNCT_DADDU 0x2D
+#define FUNCT_DSUBU 0x2F // FIX 13: from 23
+#define FUNCT_DMULT 0x1C // was 0x18 (+ 4 at the call site): 0x18 is 32-bit mult
+#define FUNCT_DDIV 0x1E // was 0x1A (+ 4), same reason
+#define FUNCT_MFHI 0x10
+#define FUNCT_MFLO 0x12
+#define FUNCT_SYSCALL 0x0C
+#define FUNCT_JR 0x08
+#define FUNCT_SLT 0x2A
+#define FUNCT_DSLL 0x38 // shift amount in the shamt field
+#define FUNCT_DSRA 0x3B
+#define FUNCT_DSLL32 0x3C
+
+// halt (EduMIPS64 encoding, ends the program b4 outlined subroutines)
+#define CODE_HALT 0x04000000
+
+// encoding table entry, indexed by Opcode
+typedef struct {
+    const char *mnemonic;
+    uint8_t format;
+    uint8_t opcode; // primary opcode (I/J) or 0 (R)
+    uint8_t funct; // R-type funct
+} InstrInfo;
+
+extern const InstrInfo instr_info[OPC_COUNT];
+
+typedef struct {
+    uint8_t op; // Opcode
+    uint8_t rd; // destination (rt of I-type loads/daddiu, value reg of sd)
+    uint8_t rs;
+    uint8_t rt;
+    int32_t sym; // symbol table id of a memory/address operand, -1 if none
+    int64_t imm; // immediate, syscall number or code label id
+    int32_t line; // source line:column of the statement it was lowered from
+    int32_t column; // (0 for code of no statement: runtime, halt, final flush)
+} Instruction;
+
+// growable instruction array
+typedef struct {
+    Instruction *code;
+    int count;
+    int capacity;
+} InstrBuffer;
+
+void InstrAppend(InstrBuffer *buf, Instruction ins);
+void InstrBufferFree(InstrBuffer *buf);
+bool InstructionEqual(const Instruction *a, const Instruction *b);
+uint64_t InstructionHash(const Instruction *ins);
+
+// code labels (jal/branch/j targets) are ids into a name table
+int NewCodeLabel(const char *name);
+const char* CodeLabelName(int id);
+void CodeLabelsReset();
+
+// print one instruction in .s syntax (w/ trailing newline)
+void PrintInstruction(const Instruction *ins, FILE *out);
+
+#endif
\ No newline at end of file
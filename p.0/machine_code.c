@@ -1,30 +1,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "machine_code.h"
+#include "instruction.h"
 #include "symbol_table.h"
-
-// I-type opcodes
-#define OP_DADDIU 0x19 // daddiu rt, rs, immediate
-#define OP_LD 0x37 // 64-bit load doubleword
-#define OP_SD 0x3F // 64-bit store doubleword
-
-// R-type function codes (funct field)
-#define FUNCT_DADDU 0x2D
-#define FUNCT_DSUBU 0x2F // FIX 13: from 23
-#define FUNCT_DMULT 0x18
-#define FUNCT_DDIV 0x1A
-#define FUNCT_MFHI 0x10
-#define FUNCT_MFLO 0x12
-#define FUNCT_SYSCALL 0x0C
-
-// map reister name "r0".."r31" to number
-// convert reg name string into number
-static int RegisterNumber(const char *r) {
-    return atoi(r + 1); // skip first character (w/c is 'r', and directly go to the first digit)
-}
+#include "assembler.h"
 
 // R-type instruction: opcode rs rt rd shamt funct
 static uint32_t Encode_R_Type(uint8_t rs, uint8_t rt, uint8_t rd, uint8_t shamt, uint8_t funct) {
@@ -33,194 +17,316 @@ static uint32_t Encode_R_Type(uint8_t rs, uint8_t rt, uint8_t rd, uint8_t shamt,
 
 // I-type instruction: opcode rs rt immediate
 static uint32_t Encode_I_Type(uint8_t opcode, uint8_t rs, uint8_t rt, int16_t imm) {
-    return (opcode << 26) | (rs << 21) | (rt << 16) | ((uint16_t)imm & 0xFFFF);
+    return ((uint32_t)opcode << 26) | (rs << 21) | (rt << 16) | ((uint16_t)imm & 0xFFFF);
 }
 
-// print 32-bit instruction in binary
-static void PrintBinary(uint32_t code, FILE *out) {
-    for(int i = 31; i >= 0; i--) {
-        fprintf(out, "%c", (code & (1U << i)) ? '1' : '0');
-        if(i % 4 == 0)
-            fprintf(out, " "); // spacing every 4 bits
+// J-type instruction: opcode target(26)
+static uint32_t Encode_J_Type(uint8_t opcode, uint32_t target) {
+    return ((uint32_t)opcode << 26) | (target & 0x3FFFFFF);
+}
+
+// encode one IR instruction via the instr_info table
+// code_label_index maps code label ids to instruction indices, pc is this
+// instruction's index (branch offsets are relative to pc + 1)
+uint32_t EncodeInstruction(const Instruction *ins, const int64_t *code_label_index, int64_t pc) {
+    const InstrInfo *info = &instr_info[ins->op];
+    switch(info->format) {
+        case FMT_R:
+            switch(ins->op) {
+                case OPC_DADDU:
+                case OPC_DSUBU:
+                    return Encode_R_Type(ins->rs, ins->rt, ins->rd, 0, info->funct);
+                case OPC_DMULT:
+                case OPC_DDIV:
+                    return Encode_R_Type(ins->rs, ins->rt, 0, 0, info->funct);
+                case OPC_MFLO:
+                case OPC_MFHI:
+                    return Encode_R_Type(0, 0, ins->rd, 0, info->funct);
+                case OPC_SYSCALL:
+                    return Encode_R_Type(0, 0, 0, (uint8_t)ins->imm, info->funct);
+                case OPC_JR:
+                    return Encode_R_Type(ins->rs, 0, 0, 0, info->funct);
+                case OPC_SLT:
+                    return Encode_R_Type(ins->rs, ins->rt, ins->rd, 0, info->funct);
+                case OPC_DSLL:
+                case OPC_DSRA:
+                case OPC_DSLL32:
+                    return Encode_R_Type(0, ins->rs, ins->rd, (uint8_t)ins->imm, info->funct);
+            }
+            break;
+        case FMT_I: {
+            if(ins->op == OPC_BEQ || ins->op == OPC_BNE)
+                return Encode_I_Type(info->opcode, ins->rs, ins->rt, (int16_t)(code_label_index[ins->imm] - (pc + 1)));
+            // memory/address operands resolve to the symbol's .data offset
+            int64_t imm = ins->sym >= 0 ? (int64_t)GetOffsetOfSymbolId(ins->sym) : ins->imm;
+            return Encode_I_Type(info->opcode, ins->rs, ins->rd, (int16_t)imm);
+        }
+        case FMT_J:
+            return Encode_J_Type(info->opcode, (uint32_t)code_label_index[ins->imm]);
+        case FMT_RAW:
+            return CODE_HALT;
     }
+    return 0;
 }
 
-// MAIN TRANSLATION SECTION
-// convert assembly to machine code, one line per assembly
-// each instrcution line is converted into a bits of integer code
-// and teh resulting binary and hex are written to out_file
-int MachineFromAssembly(const char *asm_file, const char *out_file) {
-    FILE *in = fopen(asm_file, "r");
-    if(!in)
-        return 0;
+// .data offset operand that an r0-based I-type cannot reach (data_layout.c
+// rewrites those, so this only catches what slips through instead of
+// letting the (int16_t) cast wrap it)
+static bool DataOffsetOutOfRange(const Instruction *ins) {
+    if(ins->sym < 0 || instr_info[ins->op].format != FMT_I)
+        return false;
+    int64_t offset = (int64_t)GetOffsetOfSymbolId(ins->sym);
+    return offset < INT16_MIN || offset > INT16_MAX;
+}
 
-    FILE *out = fopen(out_file, "w");
-    if(!out) { 
-        fclose(in); 
-        return 0; 
+// one .mc line is always this long: 32 bits in groups of 4 (each group w/
+// a trailing space), " : ", 8 hex digits, \n
+#define MC_LINE_LENGTH 52
+// words per chunk of the parallel writer
+#define MC_CHUNK_WORDS 65536
+// words per fwrite of the serial one
+#define MC_BLOCK_WORDS 4096
+
+// a nibble's 4 bits and the group's space
+static const char nibble_bits[16][5] = {
+    "0000 ", "0001 ", "0010 ", "0011 ", "0100 ", "0101 ", "0110 ", "0111 ",
+    "1000 ", "1001 ", "1010 ", "1011 ", "1100 ", "1101 ", "1110 ", "1111 ",
+};
+static const char hex_digits[16] = "0123456789ABCDEF";
+
+// the .mc line for a word, into p (MC_LINE_LENGTH bytes, no terminator)
+static void FormatMachineLine(uint32_t code, char *p) {
+    for(int i = 0; i < 8; i++)
+        memcpy(p + 5 * i, nibble_bits[(code >> (28 - 4 * i)) & 0xF], 5);
+    memcpy(p + 40, " : ", 3);
+    for(int i = 0; i < 8; i++)
+        p[43 + i] = hex_digits[(code >> (28 - 4 * i)) & 0xF];
+    p[51] = '\n';
+}
+
+// .mc lines for the words, MC_BLOCK_WORDS lines per fwrite
+static bool WriteMachineLines(const uint32_t *words, int64_t count, FILE *out) {
+    char *buf = malloc((size_t)MC_BLOCK_WORDS * MC_LINE_LENGTH);
+    for(int64_t first = 0; first < count; first += MC_BLOCK_WORDS) {
+        int64_t n = count - first < MC_BLOCK_WORDS ? count - first : MC_BLOCK_WORDS;
+        for(int64_t i = 0; i < n; i++)
+            FormatMachineLine(words[first + i], buf + i * MC_LINE_LENGTH);
+        fwrite(buf, MC_LINE_LENGTH, n, out);
     }
+    free(buf);
+    return ferror(out) == 0;
+}
 
-    char line[MAX_SYMBOLS];
-    while(fgets(line, sizeof(line), in)) {
-        line[strcspn(line, "\r\n")] = '\0'; // remove newline
-        char *p = line;
-        while(*p && isspace(*p)) 
-            p++;
-        if(*p == '#' || *p == '\0') 
-            continue; // skip comments/empty
-
-        ////
-        // skip assembler directives and labels
-        if(strncmp(p, ".data", 5) == 0 || strncmp(p, ".code",5) == 0)
-            continue;
-        if(strchr(p, ':'))   // labels like a: .space 8
-            continue;
-        if(strstr(line, ".asciiz"))
+// the lowered program's words (labels take none); false if a .data
+// operand is out of reach (the words are still all there)
+static bool EncodeProgram(const InstrBuffer *program, uint32_t **words, int64_t *count) {
+    // code label id -> instruction index
+    int64_t label_max = -1;
+    for(int i = 0; i < program->count; i++) {
+        if(program->code[i].op == OPC_LABEL && program->code[i].imm > label_max)
+            label_max = program->code[i].imm;
+    }
+    int64_t *code_label_index = malloc(sizeof(int64_t) * (label_max + 2));
+    int64_t index = 0;
+    for(int i = 0; i < program->count; i++) {
+        if(program->code[i].op == OPC_LABEL)
+            code_label_index[program->code[i].imm] = index;
+        else
+            index++;
+    }
+
+    *words = malloc(sizeof(uint32_t) * (index + 1));
+    int64_t pc = 0;
+    bool ok = true;
+    for(int i = 0; i < program->count; i++) {
+        if(program->code[i].op == OPC_LABEL)
             continue;
-        if(strchr(p, ';'))
-            continue; // to skip comments b4 the actual assembly (w/c is teh symbol table content 4 deugging)
-        ////
-
-        // parsed fields
-        char regA[8], regB[MAX_NAME_LEN], regC[8]; // tempoeary string buffers to use when parsing assembly instructions
-        // 3 regs since most MIPS64 instruction formats have at most 3 registers
-        // regB is MAX_NAME_LEN (64) bc it may hold memory operands like "result(r0)" or variable names, w/c can be long
-        // regA and regC are size 8 since the longest reg name is of length 3 (r10 - r31) + \0, and extra padding for safety
-        char imm_str[MAX_NAME_LEN];
-        int imm;
-        uint32_t code = 0;
-        int matched = 0; // flag for valid instruction
-
-        // daddiu w/ numeric immediate: daddiu rt, rs, #numeric
-        // %7[^,] means read up to 7 characters and stop at the comma
-        // #%i reads an int following a #
-        // sscanf(...) == 3 means all 3 fields were parsed successfully
-        if(sscanf(line, "daddiu %7[^,], %7[^,], #%i", regA, regB, &imm) == 3) {
-            int rt = RegisterNumber(regA);
-            int rs = RegisterNumber(regB); // convert rt and rs strings to reg numbers
-            if(rt >= 0 && rs >= 0) { 
-                code = Encode_I_Type(OP_DADDIU, rs, rt, imm); 
-                matched = 1; 
-            }
-        }
-//>>>>>>>> ! problematic (machine code)
-        // daddiu w/ label: daddiu rt, rs, symbol  (string labels like str0, str1)
-        else if(sscanf(p, "daddiu %15[^,], %15[^,], %63s", regA, regB, imm_str) == 3) {
-            int rt = RegisterNumber(regA);
-            int rs = RegisterNumber(regB);
-            if(rt >= 0 && rs >= 0) {
-                int offset = GetOffsetOfTheSymbol(imm_str);
-                if(offset != -1) {
-                    code = Encode_I_Type(OP_DADDIU, rs, rt, (int16_t)offset);
-                    matched = 1;
-                } else {
-                    fprintf(stderr, "Error: %s is not a known symbol\n", imm_str);
-                }
-            }
-        }
-        // daddu rd, rs, rt
-        else if(sscanf(line, "daddu %7[^,], %7[^,], %7s", regA, regB, regC) == 3) {
-            int rd = RegisterNumber(regA);
-            int rs = RegisterNumber(regB);
-            int rt = RegisterNumber(regC);
-            if(rd >= 0 && rs >= 0 && rt >= 0) { 
-                code = Encode_R_Type(rs, rt, rd, 0, FUNCT_DADDU); 
-                matched = 1; 
-            }
-        }
-        // dsubu
-        else if(sscanf(line, "dsubu %7[^,], %7[^,], %7s", regA, regB, regC) == 3) {
-            int rd = RegisterNumber(regA);
-            int rs = RegisterNumber(regB);
-            int rt = RegisterNumber(regC);
-            if(rd >= 0 && rs >= 0 && rt >= 0) { 
-                code = Encode_R_Type(rs, rt, rd, 0, FUNCT_DSUBU);
-                matched = 1;
-            }
+        if(DataOffsetOutOfRange(&program->code[i])) {
+            fprintf(stderr, "Error: %s is out of 16-bit reach\n", GetSymbolName(program->code[i].sym));
+            ok = false;
         }
-        // dmult
-        else if(sscanf(line, "dmult %7[^,], %7s", regA, regB) == 2) {
-            int rs = RegisterNumber(regA);
-            int rt = RegisterNumber(regB);
-            if(rs >= 0 && rt >= 0) {
-                code = Encode_R_Type(rs, rt, 0, 0, FUNCT_DMULT + 4); // + 4 bc 0x1C - 0x18 = 0x04 (this outputs ...18 while in the simlator it is ...1C); same for ddiv
-                matched = 1; 
-            }
-        }
-        // ddiv
-        else if(sscanf(line, "ddiv %7[^,], %7s", regA, regB) == 2) {
-            int rs = RegisterNumber(regA);
-            int rt = RegisterNumber(regB);
-            if(rs >= 0 && rt >= 0) { 
-                code = Encode_R_Type(rs, rt, 0, 0, FUNCT_DDIV + 4);  
-                matched = 1; 
-            }
-        }
-        // mflo
-        else if(sscanf(line, "mflo %7s", regA) == 1) {
-            int rd = RegisterNumber(regA);
-            if(rd >= 0) {
-                code = Encode_R_Type(0, 0, rd, 0, FUNCT_MFLO);
-                matched = 1;
-            }
-        }
-        // mfhi
-        else if(sscanf(line, "mfhi %7s", regA) == 1) {
-            int rd = RegisterNumber(regA);
-            if(rd >= 0 ){ 
-                code = Encode_R_Type(0, 0, rd, 0, FUNCT_MFHI); 
-                matched = 1; 
-            }
-        }
-        // ld (load doubleword)
-        else if(sscanf(line, "ld %7[^,], %7[^)]", regA, regB) == 2) {
-            int rt = RegisterNumber(regA);
-            int rs = 0;
-            int16_t imm = 0;
-            char var_name[MAX_NAME_LEN] = {0};
-            sscanf(regB, "%63[^ (]", var_name);
-            imm = (int16_t)GetOffsetOfTheSymbol(var_name);
-            if(rt >= 0) {
-                code = Encode_I_Type(OP_LD, rs, rt, imm);
-                matched = 1;
-            }
-        }
-        // sd (store doubleword)
-        else if(sscanf(line, "sd %7[^,], %7[^)]", regA, regB) == 2) {
-            int rt = RegisterNumber(regA);
-            int rs = 0;
-            int16_t imm = 0;
-            char var_name[MAX_NAME_LEN] = {0};
-            sscanf(regB, "%63[^ (]", var_name);
-            imm = (int16_t)GetOffsetOfTheSymbol(var_name);
-            if(rt >= 0) {
-                code = Encode_I_Type(OP_SD, rs, rt, imm);
-                matched = 1;
-            }
-        } 
+        (*words)[pc] = EncodeInstruction(&program->code[i], code_label_index, pc);
+        pc++;
+    }
+    *count = pc;
+    free(code_label_index);
+    return ok;
+}
+
+// write binary + hex lines for the lowered program (no .s round trip)
+int MachineFromInstructions(const InstrBuffer *program, const char *out_file) {
+    FILE *out = fopen(out_file, "w");
+    if(!out)
+        return 0;
+
+    uint32_t *words;
+    int64_t count;
+    int ok = EncodeProgram(program, &words, &count);
+    ok = WriteMachineLines(words, count, out) && ok;
+
+    free(words);
+    ok = fclose(out) == 0 && ok;
+    return ok;
+}
+
+// the lowered program as an assembled one: its words, the .data image
+// laid out from data_text (the .data section as .s text, see
+// AssemblyDataText) and all labels, .data ones then the code ones
+bool ProgramFromInstructions(const InstrBuffer *program, const char *data_text, size_t data_len, AsmProgram *image) {
+    bool ok = AssembleText(data_text, data_len, "(.data)", 1, image);
+    free(image->code);
+    ok = EncodeProgram(program, &image->code, &image->code_count) && ok;
 
-        // syscall with number - like syscall 4
-        else if(sscanf(line, "syscall %d", &imm) == 1) {
-            code = Encode_R_Type(0, 0, 0, imm, FUNCT_SYSCALL);
-            matched = 1;
+    int64_t labels = 0;
+    for(int i = 0; i < program->count; i++)
+        labels += program->code[i].op == OPC_LABEL;
+    image->symbols = realloc(image->symbols, sizeof(AsmSymbol) * (image->symbol_count + labels + 1));
+    int64_t pc = 0;
+    for(int i = 0; i < program->count; i++) {
+        if(program->code[i].op != OPC_LABEL) {
+            pc++;
+            continue;
         }
+        AsmSymbol *symbol = &image->symbols[image->symbol_count++];
+        symbol->name = strdup(CodeLabelName(program->code[i].imm));
+        symbol->code = true;
+        symbol->value = pc;
+    }
+    return ok;
+}
 
-        // syscall without number - like syscall
-        else if(strncmp(p, "syscall", 7) == 0) {
-            code = Encode_R_Type(0, 0, 0, 0, FUNCT_SYSCALL);
-            matched = 1;
+// raw/ihex/elf image of the lowered program
+int MachineImageFromInstructions(const InstrBuffer *program, const char *data_text, size_t data_len,
+                                 MachineFormat format, const char *out_file) {
+    AsmProgram image;
+    int ok = ProgramFromInstructions(program, data_text, data_len, &image);
+    ok = WriteMachineImage(&image, format, out_file, 1) && ok;
+    AsmProgramFree(&image);
+    return ok;
+}
+
+// .p0map side table: which source line each .code word came from
+//   p0map 1 <source file>
+//   <pc> <words> <line>:<column>   one line per run of words from the same
+//                                  statement (pc = word index, as in jal;
+//                                  line 0: no statement, e.g. runtime code)
+int LineMapFromInstructions(const InstrBuffer *program, const char *source, const char *out_file) {
+    FILE *out = fopen(out_file, "w");
+    if(!out)
+        return 0;
+    fprintf(out, "p0map 1 %s\n", source);
+
+    int64_t pc = 0, run_start = 0;
+    int line = -1, column = -1;
+    for(int i = 0; i < program->count; i++) {
+        const Instruction *ins = &program->code[i];
+        if(ins->op == OPC_LABEL)
+            continue;
+        if(ins->line != line || ins->column != column) {
+            if(pc > run_start)
+                fprintf(out, "%lld %lld %d:%d\n", (long long)run_start, (long long)(pc - run_start), line, column);
+            run_start = pc;
+            line = ins->line;
+            column = ins->column;
         }
-        //////////////
+        pc++;
+    }
+    if(pc > run_start)
+        fprintf(out, "%lld %lld %d:%d\n", (long long)run_start, (long long)(pc - run_start), line, column);
+
+    bool ok = ferror(out) == 0;
+    return fclose(out) == 0 && ok;
+}
 
-        if(matched) {
-            PrintBinary(code, out);
-            fprintf(out," : %08X\n", code); // hex representation
-        } else {
-            fprintf(stderr,"Warning: could not parse line: %s\n", line);
+// parallel writer: chunk k of the words is line-for-line at byte offset
+// k * MC_CHUNK_WORDS * MC_LINE_LENGTH of the file (lines are fixed size)
+typedef struct {
+    const uint32_t *words;
+    int64_t count;
+    int fd;
+    int64_t next_chunk;
+    int64_t chunk_count;
+    bool ok;
+    pthread_mutex_t lock;
+} MachineWork;
+
+// format each claimed chunk in a buffer and write it w/ one pwrite
+static void* MachineWorker(void *arg) {
+    MachineWork *work = arg;
+    char *buf = malloc((size_t)MC_CHUNK_WORDS * MC_LINE_LENGTH);
+    for(;;) {
+        pthread_mutex_lock(&work->lock);
+        int64_t k = work->next_chunk++;
+        pthread_mutex_unlock(&work->lock);
+        if(k >= work->chunk_count)
+            break;
+        int64_t first = k * MC_CHUNK_WORDS;
+        int64_t last = first + MC_CHUNK_WORDS < work->count ? first + MC_CHUNK_WORDS : work->count;
+        for(int64_t i = first; i < last; i++)
+            FormatMachineLine(work->words[i], buf + (i - first) * MC_LINE_LENGTH);
+        size_t size = (size_t)(last - first) * MC_LINE_LENGTH;
+        off_t offset = (off_t)first * MC_LINE_LENGTH;
+        // (a short write only continues where it stopped)
+        for(size_t done = 0; done < size; ) {
+            ssize_t n = pwrite(work->fd, buf + done, size - done, offset + done);
+            if(n <= 0) {
+                pthread_mutex_lock(&work->lock);
+                work->ok = false;
+                pthread_mutex_unlock(&work->lock);
+                break;
+            }
+            done += n;
         }
     }
+    free(buf);
+    return NULL;
+}
 
-    fclose(in);
-    fclose(out);
-    return 1;
+// .mc lines for words that are alr encoded (p0as)
+// jobs > 1: chunks formatted on threads, each written w/ its own pwrite
+// into the file sized up front (same bytes as the serial path)
+int MachineFromWords(const uint32_t *words, int64_t count, const char *out_file, int jobs) {
+    if(jobs <= 1 || count <= MC_CHUNK_WORDS) {
+        FILE *out = fopen(out_file, "w");
+        if(!out)
+            return 0;
+        bool ok = WriteMachineLines(words, count, out);
+        return fclose(out) == 0 && ok;
+    }
+
+    int fd = open(out_file, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0)
+        return 0;
+    MachineWork work = { .words = words, .count = count, .fd = fd, .next_chunk = 0, .ok = true };
+    work.chunk_count = (count + MC_CHUNK_WORDS - 1) / MC_CHUNK_WORDS;
+    work.ok = ftruncate(fd, (off_t)count * MC_LINE_LENGTH) == 0;
+    pthread_mutex_init(&work.lock, NULL);
+
+    // this thread works too
+    int threads = jobs < work.chunk_count ? jobs : (int)work.chunk_count;
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    int started = 0;
+    for(int t = 1; t < threads; t++) {
+        if(pthread_create(&workers[started], NULL, MachineWorker, &work) == 0)
+            started++;
+    }
+    MachineWorker(&work);
+    for(int t = 0; t < started; t++)
+        pthread_join(workers[t], NULL);
+    free(workers);
+    pthread_mutex_destroy(&work.lock);
+    return close(fd) == 0 && work.ok;
 }
+
+// text path: assemble a .s file on its own (assembler.c, no compiler state)
+// and write its .mc; 0 if it can't be read or doesn't assemble
+int MachineFromAssembly(const char *asm_file, const char *out_file) {
+    AsmProgram program;
+    if(!AssembleFile(asm_file, 1, &program)) {
+        AsmProgramFree(&program);
+        return 0;
+    }
+    int ok = MachineFromWords(program.code, program.code_count, out_file, 1);
+    AsmProgramFree(&program);
+    return ok;
+}
\ No newline at end of file
@@ -2,7 +2,23 @@
 #define MACHINE_CODE_H
 
 #include <stdio.h>
+#include <stdint.h>
+
+#include "instruction.h"
+#include "machine_image.h"
 
 int MachineFromAssembly(const char *asm_file, const char *out_file);
+int MachineFromWords(const uint32_t *words, int64_t count, const char *out_file, int jobs); // jobs > 1: threads + pwrite
+int MachineFromInstructions(const InstrBuffer *program, const char *out_file);
+// words + .data image + labels (data_text: the .data section as .s text)
+bool ProgramFromInstructions(const InstrBuffer *program, const char *data_text, size_t data_len, AsmProgram *image);
+// --mc-format=raw|ihex|elf
+int MachineImageFromInstructions(const InstrBuffer *program, const char *data_text, size_t data_len,
+                                 MachineFormat format, const char *out_file);
+int LineMapFromInstructions(const InstrBuffer *program, const char *source, const char *out_file); // .p0map
+
+// one IR instruction as a word; code_label_index maps jal/branch label
+// ids (imm) to instruction indices, pc is the instruction's own index
+uint32_t EncodeInstruction(const Instruction *ins, const int64_t *code_label_index, int64_t pc);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <elf.h>
+#include "machine_image.h"
+#include "machine_code.h"
+
+static const struct {
+    const char *name;
+    const char *extension;
+} formats[] = {
+    [MC_FORMAT_TEXT] = { "text", ".mc" },
+    [MC_FORMAT_RAW]  = { "raw",  ".bin" },
+    [MC_FORMAT_IHEX] = { "ihex", ".hex" },
+    [MC_FORMAT_ELF]  = { "elf",  ".elf" },
+};
+
+bool ParseMachineFormat(const char *name, MachineFormat *format) {
+    for(int i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++) {
+        if(strcmp(name, formats[i].name) == 0) {
+            *format = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* MachineFormatExtension(MachineFormat format) {
+    return formats[format].extension;
+}
+
+typedef struct {
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+} ByteBuffer;
+
+static void Append(ByteBuffer *buf, const void *data, size_t n) {
+    if(buf->count + n > buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        while(buf->capacity < buf->count + n)
+            buf->capacity *= 2;
+        buf->bytes = realloc(buf->bytes, buf->capacity);
+    }
+    if(n > 0)
+        memcpy(buf->bytes + buf->count, data, n);
+    buf->count += n;
+}
+
+// big-endian fields (the words are, so the ELF file is MSB too)
+static void Put(ByteBuffer *buf, uint64_t value, int size) {
+    uint8_t b[8];
+    for(int i = 0; i < size; i++)
+        b[i] = (uint8_t)(value >> (8 * (size - 1 - i)));
+    Append(buf, b, size);
+}
+
+static void PutZeros(ByteBuffer *buf, size_t n) {
+    static const uint8_t zeros[64] = { 0 };
+    Append(buf, zeros, n);
+}
+
+static void PadTo(ByteBuffer *buf, size_t align) {
+    PutZeros(buf, (align - buf->count % align) % align);
+}
+
+// .code words, zeros to a multiple of 8, .data
+static void FlatImage(const AsmProgram *program, ByteBuffer *image) {
+    for(int64_t i = 0; i < program->code_count; i++)
+        Put(image, program->code[i], 4);
+    PadTo(image, 8);
+    Append(image, program->data, program->data_size);
+}
+
+// Intel HEX: 16-byte data records, an extended linear address record (04)
+// whenever the upper 16 address bits change, then the EOF record
+static void HexRecord(FILE *out, int type, uint16_t address, const uint8_t *bytes, int n) {
+    uint8_t sum = n + (address >> 8) + (address & 0xFF) + type;
+    fprintf(out, ":%02X%04X%02X", n, address, type);
+    for(int i = 0; i < n; i++) {
+        fprintf(out, "%02X", bytes[i]);
+        sum += bytes[i];
+    }
+    fprintf(out, "%02X\n", (uint8_t)-sum);
+}
+
+static void WriteIntelHex(FILE *out, const ByteBuffer *image) {
+    uint32_t upper = 0;
+    for(size_t address = 0; address < image->count; address += 16) {
+        if(address >> 16 != upper) {
+            upper = address >> 16;
+            uint8_t b[2] = { upper >> 8, upper & 0xFF };
+            HexRecord(out, 4, 0, b, 2);
+        }
+        int n = image->count - address < 16 ? (int)(image->count - address) : 16;
+        HexRecord(out, 0, address & 0xFFFF, image->bytes + address, n);
+    }
+    HexRecord(out, 1, 0, NULL, 0);
+}
+
+// section header name offsets in shstrtab
+static const char shstrtab[] = "\0.text\0.data\0.symtab\0.strtab\0.shstrtab";
+enum { NAME_TEXT = 1, NAME_DATA = 7, NAME_SYMTAB = 13, NAME_STRTAB = 21, NAME_SHSTRTAB = 29 };
+enum { SEC_TEXT = 1, SEC_DATA, SEC_SYMTAB, SEC_STRTAB, SEC_SHSTRTAB, SEC_COUNT };
+
+static void PutSectionHeader(ByteBuffer *buf, uint32_t name, uint32_t type, uint64_t flags, uint64_t offset,
+                             uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entsize) {
+    Put(buf, name, 4);
+    Put(buf, type, 4);
+    Put(buf, flags, 8);
+    Put(buf, 0, 8); // sh_addr: both sections start at 0 (code and data are separate memories)
+    Put(buf, offset, 8);
+    Put(buf, size, 8);
+    Put(buf, link, 4);
+    Put(buf, info, 4);
+    Put(buf, align, 8);
+    Put(buf, entsize, 8);
+}
+
+// bytes up to the next .data label (or the end): the label's st_size
+static uint64_t DataSymbolSize(const AsmProgram *program, int64_t i) {
+    uint64_t value = program->symbols[i].value;
+    for(int64_t j = i + 1; j < program->symbol_count; j++) {
+        if(!program->symbols[j].code && program->symbols[j].value >= value)
+            return program->symbols[j].value - value;
+    }
+    return program->data_size - value;
+}
+
+// ELF64 relocatable object (nothing to relocate: addresses are final, the
+// code counts in words from 0 and .data is addressed from 0 through r0)
+// layout: header, .text, .data, .symtab, .strtab, .shstrtab, section headers
+static void ElfImage(const AsmProgram *program, ByteBuffer *elf) {
+    ByteBuffer symtab = { 0 }, strtab = { 0 };
+    Append(&strtab, "", 1);
+    PutZeros(&symtab, sizeof(Elf64_Sym)); // symbol 0
+    for(int64_t i = 0; i < program->symbol_count; i++) {
+        const AsmSymbol *symbol = &program->symbols[i];
+        Put(&symtab, strtab.count, 4);
+        Append(&strtab, symbol->name, strlen(symbol->name) + 1);
+        if(symbol->code) {
+            Put(&symtab, ELF64_ST_INFO(STB_LOCAL, STT_NOTYPE), 1);
+            Put(&symtab, STV_DEFAULT, 1);
+            Put(&symtab, SEC_TEXT, 2);
+            Put(&symtab, symbol->value * 4, 8);
+            Put(&symtab, 0, 8);
+        } else {
+            Put(&symtab, ELF64_ST_INFO(STB_LOCAL, STT_OBJECT), 1);
+            Put(&symtab, STV_DEFAULT, 1);
+            Put(&symtab, SEC_DATA, 2);
+            Put(&symtab, symbol->value, 8);
+            Put(&symtab, DataSymbolSize(program, i), 8);
+        }
+    }
+
+    uint64_t text_offset = sizeof(Elf64_Ehdr);
+    uint64_t text_size = (uint64_t)program->code_count * 4;
+    uint64_t data_offset = (text_offset + text_size + 7) & ~(uint64_t)7;
+    uint64_t symtab_offset = (data_offset + program->data_size + 7) & ~(uint64_t)7;
+    uint64_t strtab_offset = symtab_offset + symtab.count;
+    uint64_t shstrtab_offset = strtab_offset + strtab.count;
+    uint64_t sh_offset = (shstrtab_offset + sizeof(shstrtab) + 7) & ~(uint64_t)7;
+
+    uint8_t ident[EI_NIDENT] = { 0 };
+    memcpy(ident, ELFMAG, SELFMAG);
+    ident[EI_CLASS] = ELFCLASS64;
+    ident[EI_DATA] = ELFDATA2MSB;
+    ident[EI_VERSION] = EV_CURRENT;
+    ident[EI_OSABI] = ELFOSABI_SYSV;
+    Append(elf, ident, EI_NIDENT);
+    Put(elf, ET_REL, 2);
+    Put(elf, EM_MIPS, 2);
+    Put(elf, EV_CURRENT, 4);
+    Put(elf, 0, 8); // e_entry: the first word
+    Put(elf, 0, 8); // no program headers
+    Put(elf, sh_offset, 8);
+    Put(elf, EF_MIPS_ARCH_64, 4);
+    Put(elf, sizeof(Elf64_Ehdr), 2);
+    Put(elf, 0, 2);
+    Put(elf, 0, 2);
+    Put(elf, sizeof(Elf64_Shdr), 2);
+    Put(elf, SEC_COUNT, 2);
+    Put(elf, SEC_SHSTRTAB, 2);
+
+    for(int64_t i = 0; i < program->code_count; i++)
+        Put(elf, program->code[i], 4);
+    PadTo(elf, 8);
+    Append(elf, program->data, program->data_size);
+    PadTo(elf, 8);
+    Append(elf, symtab.bytes, symtab.count);
+    Append(elf, strtab.bytes, strtab.count);
+    Append(elf, shstrtab, sizeof(shstrtab));
+    PadTo(elf, 8);
+
+    PutZeros(elf, sizeof(Elf64_Shdr)); // section 0
+    PutSectionHeader(elf, NAME_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text_offset, text_size, 0, 0, 4, 0);
+    PutSectionHeader(elf, NAME_DATA, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, data_offset, program->data_size, 0, 0, 8, 0);
+    // sh_info: index of the first non-local symbol (all are local)
+    PutSectionHeader(elf, NAME_SYMTAB, SHT_SYMTAB, 0, symtab_offset, symtab.count, SEC_STRTAB,
+                     program->symbol_count + 1, 8, sizeof(Elf64_Sym));
+    PutSectionHeader(elf, NAME_STRTAB, SHT_STRTAB, 0, strtab_offset, strtab.count, 0, 0, 1, 0);
+    PutSectionHeader(elf, NAME_SHSTRTAB, SHT_STRTAB, 0, shstrtab_offset, sizeof(shstrtab), 0, 0, 1, 0);
+
+    free(symtab.bytes);
+    free(strtab.bytes);
+}
+
+int WriteMachineImage(const AsmProgram *program, MachineFormat format, const char *out_file, int jobs) {
+    if(format == MC_FORMAT_TEXT)
+        return MachineFromWords(program->code, program->code_count, out_file, jobs);
+
+    FILE *out = fopen(out_file, format == MC_FORMAT_IHEX ? "w" : "wb");
+    if(!out)
+        return 0;
+    ByteBuffer image = { 0 };
+    if(format == MC_FORMAT_ELF) {
+        ElfImage(program, &image);
+        fwrite(image.bytes, 1, image.count, out);
+    } else {
+        FlatImage(program, &image);
+        if(format == MC_FORMAT_RAW)
+            fwrite(image.bytes, 1, image.count, out);
+        else
+            WriteIntelHex(out, &image);
+    }
+    free(image.bytes);
+    bool ok = ferror(out) == 0;
+    return fclose(out) == 0 && ok;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef MACHINE_IMAGE_H
+#define MACHINE_IMAGE_H
+
+#include <stdbool.h>
+#include "assembler.h"
+
+// --mc-format: what the machine code file holds
+//   text  .mc lines (32 bits in groups of 4, then the hex), the default
+//   raw   .code words then .data (from the next multiple of 8), big-endian
+//   ihex  that same image as Intel HEX records
+//   elf   ELF64 MIPS relocatable: .text, .data, .symtab w/ every label
+typedef enum {
+    MC_FORMAT_TEXT,
+    MC_FORMAT_RAW,
+    MC_FORMAT_IHEX,
+    MC_FORMAT_ELF,
+} MachineFormat;
+
+bool ParseMachineFormat(const char *name, MachineFormat *format);
+const char* MachineFormatExtension(MachineFormat format); // ".mc", ".bin", ".hex", ".elf"
+
+// jobs: writer threads for the text format (see MachineFromWords)
+int WriteMachineImage(const AsmProgram *program, MachineFormat format, const char *out_file, int jobs);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "outliner.h"
+
+// longest/shortest run considered for outlining
+#define OUTLINE_MAX_LEN 16
+#define OUTLINE_MIN_LEN 2
+
+// return address register used by jal/jr (never handed out by codegen)
+#define REG_RA 31
+
+typedef struct {
+    uint64_t hash;
+    int start;
+} Window;
+
+// labels and control transfers stay where they are
+static bool IsOutlinable(const Instruction *ins) {
+    return ins->op != OPC_LABEL && ins->op != OPC_JAL && ins->op != OPC_JR &&
+           ins->op != OPC_HALT && ins->op != OPC_J && ins->op != OPC_BEQ && ins->op != OPC_BNE;
+}
+
+static int CompareWindows(const void *a, const void *b) {
+    const Window *x = a, *y = b;
+    if(x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return x->start - y->start;
+}
+
+static bool SameRun(const Instruction *code, int a, int b, int len) {
+    for(int i = 0; i < len; i++) {
+        if(!InstructionEqual(&code[a + i], &code[b + i]))
+            return false;
+    }
+    return true;
+}
+
+// instructions saved by outlining k copies of a len-long run:
+// k*len before, k jal + len body + 1 jr after
+static long OutlineSavings(int k, int len) {
+    return (long)k * len - k - len - 1;
+}
+
+// greedy hashing-based outliner
+// longest runs first; for each length every window is hashed (polynomial hash
+// over per-instruction hashes), sorted, and equal-hash groups are compared
+// instruction by instruction. non-overlapping copies are replaced if that saves instructions.
+// replaced instructions are locked so shorter runs never cut into a call site.
+int OutlineRepeatedSequences(InstrBuffer *buf) {
+    int n = buf->count;
+    if(n < OUTLINE_MIN_LEN * 2)
+        return 0;
+
+    uint64_t *ins_hash = malloc(sizeof(uint64_t) * n);
+    bool *locked = calloc(n, sizeof(bool)); // label, control transfer or alr outlined
+    int *call_to = malloc(sizeof(int) * n); // subroutine id replacing this run (or -1)
+    int *removed = calloc(n, sizeof(int)); // instruction folded into a call
+    Window *windows = malloc(sizeof(Window) * n);
+    bool *used = malloc(sizeof(bool) * n);
+
+    for(int i = 0; i < n; i++) {
+        ins_hash[i] = InstructionHash(&buf->code[i]);
+        locked[i] = !IsOutlinable(&buf->code[i]);
+        call_to[i] = -1;
+    }
+
+    // subroutine bodies: start index into the original stream + length
+    int *sub_start = NULL, *sub_len = NULL;
+    int sub_count = 0, sub_capacity = 0;
+
+    for(int len = OUTLINE_MAX_LEN; len >= OUTLINE_MIN_LEN; len--) {
+        // collect windows w/ no locked instruction inside
+        int wcount = 0;
+        int run = 0; // consecutive unlocked instructions ending at i
+        for(int i = 0; i < n; i++) {
+            run = locked[i] ? 0 : run + 1;
+            if(run >= len) {
+                int start = i - len + 1;
+                uint64_t h = 0;
+                for(int j = 0; j < len; j++)
+                    h = h * 1000003ULL + ins_hash[start + j];
+                windows[wcount].hash = h;
+                windows[wcount].start = start;
+                wcount++;
+            }
+        }
+        qsort(windows, wcount, sizeof(Window), CompareWindows);
+
+        for(int g = 0; g < wcount; ) {
+            int end = g;
+            while(end < wcount && windows[end].hash == windows[g].hash)
+                end++;
+            if(end - g < 2) {
+                g = end;
+                continue;
+            }
+
+            // split the group by actual content (hash collisions)
+            for(int i = g; i < end; i++)
+                used[i - g] = false;
+            for(int ref = g; ref < end; ref++) {
+                if(used[ref - g])
+                    continue;
+                // pick non-overlapping copies (sorted by start)
+                int ref_start = windows[ref].start;
+                int copies = 0, last_end = -1, first = -1;
+                for(int i = ref; i < end; i++) {
+                    if(used[i - g])
+                        continue;
+                    int s = windows[i].start;
+                    if(!SameRun(buf->code, ref_start, s, len))
+                        continue;
+                    used[i - g] = true;
+                    if(s < last_end)
+                        continue;
+                    // earlier groups may have locked part of this window
+                    bool free_run = true;
+                    for(int j = 0; j < len && free_run; j++)
+                        free_run = !locked[s + j];
+                    if(!free_run)
+                        continue;
+                    windows[i].start = -1 - s; // tag as selected
+                    last_end = s + len;
+                    if(first < 0)
+                        first = s;
+                    copies++;
+                }
+                bool take = copies >= 2 && OutlineSavings(copies, len) > 0;
+                if(take) {
+                    if(sub_count >= sub_capacity) {
+                        sub_capacity = sub_capacity ? sub_capacity * 2 : 16;
+                        sub_start = realloc(sub_start, sizeof(int) * sub_capacity);
+                        sub_len = realloc(sub_len, sizeof(int) * sub_capacity);
+                    }
+                    sub_start[sub_count] = first;
+                    sub_len[sub_count] = len;
+                }
+                // apply (or undo the tags)
+                for(int i = ref; i < end; i++) {
+                    if(windows[i].start >= 0)
+                        continue;
+                    int s = -1 - windows[i].start;
+                    windows[i].start = s;
+                    if(!take)
+                        continue;
+                    call_to[s] = sub_count;
+                    for(int j = 0; j < len; j++) {
+                        locked[s + j] = true;
+                        if(j > 0)
+                            removed[s + j] = 1;
+                    }
+                }
+                if(take)
+                    sub_count++;
+            }
+            g = end;
+        }
+    }
+
+    if(sub_count > 0) {
+        // rebuild: main stream w/ calls, halt, then the subroutines
+        // (bodies are copied out of the old stream b4 it is freed)
+        InstrBuffer result = {0};
+        int *sub_label = malloc(sizeof(int) * sub_count);
+        for(int s = 0; s < sub_count; s++) {
+            char name[32];
+            sprintf(name, "sub%d", s);
+            sub_label[s] = NewCodeLabel(name);
+        }
+        for(int i = 0; i < n; i++) {
+            if(call_to[i] >= 0) {
+                Instruction call = { .op = OPC_JAL, .sym = -1, .imm = sub_label[call_to[i]],
+                                     .line = buf->code[i].line, .column = buf->code[i].column };
+                InstrAppend(&result, call);
+            } else if(!removed[i]) {
+                InstrAppend(&result, buf->code[i]);
+            }
+        }
+        Instruction halt = { .op = OPC_HALT, .sym = -1 };
+        InstrAppend(&result, halt);
+        for(int s = 0; s < sub_count; s++) {
+            Instruction label = { .op = OPC_LABEL, .sym = -1, .imm = sub_label[s] };
+            InstrAppend(&result, label);
+            for(int j = 0; j < sub_len[s]; j++)
+                InstrAppend(&result, buf->code[sub_start[s] + j]);
+            Instruction ret = { .op = OPC_JR, .rs = REG_RA, .sym = -1 };
+            InstrAppend(&result, ret);
+        }
+        InstrBufferFree(buf);
+        *buf = result;
+        free(sub_label);
+    }
+
+    free(ins_hash);
+    free(locked);
+    free(call_to);
+    free(removed);
+    free(windows);
+    free(used);
+    free(sub_start);
+    free(sub_len);
+    return sub_count;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef OUTLINER_H
+#define OUTLINER_H
+
+#include "instruction.h"
+
+// -Os pass: replace repeated instruction sequences with jal to a shared
+// subroutine ending in jr r31; returns number of subroutines created
+int OutlineRepeatedSequences(InstrBuffer *buf);
+
+#endif
\ No newline at end of file
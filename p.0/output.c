@@ -17,7 +17,7 @@ void capture_write(OutputCapture *cap, const char *str) {
         cap->capacity = (cap->size + len + 1) * 2;
         cap->buffer = realloc(cap->buffer, cap->capacity);
     }
-    strcat(cap->buffer, str);
+    memcpy(cap->buffer + cap->size, str, len + 1); // (strcat rescanned the whole output)
     cap->size += len;
 }
 
@@ -25,9 +25,19 @@ void capture_printf(OutputCapture *cap, const char *format, ...) {
     char buffer[1024];
     va_list args;
     va_start(args, format);
-    vsnprintf(buffer, sizeof(buffer), format, args);
+    int len = vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
-    capture_write(cap, buffer);
+    if(len < (int)sizeof(buffer)) {
+        capture_write(cap, buffer);
+        return;
+    }
+    // longer than the stack buffer (a long string literal): format again
+    char *text = malloc(len + 1);
+    va_start(args, format);
+    vsnprintf(text, len + 1, format, args);
+    va_end(args);
+    capture_write(cap, text);
+    free(text);
 }
 
 void capture_free(OutputCapture *cap) {
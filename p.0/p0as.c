@@ -0,0 +1,70 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "assembler.h"
+#include "machine_image.h"
+
+// p0as: standalone assembler, file.s -> file.mc (same format as the compiler's)
+//   p0as file.s [-o file.mc] [--jobs=N | -jN] [--mc-format=text|raw|ihex|elf]
+// encoding and writing run on N threads (default: one per online CPU)
+int main(int argc, char **argv) {
+    const char *in_file = NULL;
+    const char *out_file = NULL;
+    int usage = 0;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    MachineFormat format = MC_FORMAT_TEXT;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if(strncmp(argv[i], "--mc-format=", 12) == 0) {
+            if(!ParseMachineFormat(argv[i] + 12, &format)) {
+                fprintf(stderr, "Error: unknown machine code format %s (text, raw, ihex, elf)\n", argv[i] + 12);
+                return 1;
+            }
+        } else if(strncmp(argv[i], "--jobs=", 7) == 0 || strncmp(argv[i], "-j", 2) == 0) {
+            const char *count = argv[i] + (argv[i][1] == 'j' ? 2 : 7);
+            char *end;
+            jobs = strtol(count, &end, 10);
+            if(end == count || *end || jobs < 1) {
+                fprintf(stderr, "Error: bad job count %s\n", count);
+                return 1;
+            }
+        } else if(!in_file) {
+            in_file = argv[i];
+        } else {
+            usage = 1; // one input only
+        }
+    }
+    if(jobs < 1)
+        jobs = 1;
+    if(!in_file || usage) {
+        fprintf(stderr, "Usage: %s <file.s> [-o file.mc] [--jobs=N] [--mc-format=text|raw|ihex|elf]\n", argv[0]);
+        return 1;
+    }
+
+    // default output: the input w/ .s replaced by (or w/) .mc, .bin, .hex or .elf
+    char *default_out = NULL;
+    if(!out_file) {
+        size_t len = strlen(in_file);
+        const char *ext = MachineFormatExtension(format);
+        default_out = malloc(len + strlen(ext) + 1);
+        if(len > 2 && strcmp(in_file + len - 2, ".s") == 0)
+            sprintf(default_out, "%.*s%s", (int)(len - 2), in_file, ext);
+        else
+            sprintf(default_out, "%s%s", in_file, ext);
+        out_file = default_out;
+    }
+
+    AsmProgram program;
+    int status = 0;
+    if(!AssembleFile(in_file, (int)jobs, &program)) {
+        status = 1;
+    } else if(!WriteMachineImage(&program, format, out_file, (int)jobs)) {
+        fprintf(stderr, "Error: Cannot write machine code file %s\n", out_file);
+        status = 1;
+    }
+    AsmProgramFree(&program);
+    free(default_out);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "assembler.h"
+#include "disassembler.h"
+
+// p0dis: .mc words back to assembly
+//   p0dis file.mc [-o file.s]         the hex column of a .mc
+//   p0dis --raw file.bin [-o file.s]  big-endian words
+//   p0dis --verify file.s ...         round trip each file (see Verify)
+
+// first index where two word arrays differ, -1 if they are the same
+static int64_t FirstDifference(const uint32_t *a, int64_t a_count, const uint32_t *b, int64_t b_count) {
+    int64_t n = a_count < b_count ? a_count : b_count;
+    for(int64_t i = 0; i < n; i++) {
+        if(a[i] != b[i])
+            return i;
+    }
+    return a_count == b_count ? -1 : n;
+}
+
+static void ReportDifference(const char *file, const char *what, const uint32_t *a, int64_t a_count,
+                             const uint32_t *b, int64_t b_count, int64_t pc) {
+    if(pc >= a_count || pc >= b_count)
+        fprintf(stderr, "%s: %s: %lld words vs %lld\n", file, what, (long long)a_count, (long long)b_count);
+    else
+        fprintf(stderr, "%s: %s: word %lld is %08X vs %08X\n", file, what, (long long)pc, a[pc], b[pc]);
+}
+
+// assemble the file, disassemble the words and assemble that again: the
+// words must come back the same and the text must be a fixed point
+// (disassembling the new words gives the same text); a .mc next to a .s
+// (what the compiler wrote for it) must hold the same words too
+static bool Verify(const char *file) {
+    AsmProgram program, again;
+    char *text = NULL, *text_again = NULL;
+    size_t len = 0, len_again = 0;
+    bool ok = AssembleFile(file, 1, &program);
+    memset(&again, 0, sizeof(again));
+
+    if(ok && !DisassembleWords(program.code, program.code_count, &text, &len)) {
+        fprintf(stderr, "%s: some words do not disassemble\n", file);
+        ok = false;
+    }
+    if(ok && !AssembleText(text, len, "(disassembly)", 1, &again)) {
+        fprintf(stderr, "%s: the disassembly does not assemble\n", file);
+        ok = false;
+    }
+    if(ok) {
+        int64_t pc = FirstDifference(program.code, program.code_count, again.code, again.code_count);
+        if(pc >= 0) {
+            ReportDifference(file, "round trip", program.code, program.code_count, again.code, again.code_count, pc);
+            ok = false;
+        }
+    }
+    if(ok) {
+        DisassembleWords(again.code, again.code_count, &text_again, &len_again);
+        if(len != len_again || memcmp(text, text_again, len) != 0) {
+            fprintf(stderr, "%s: the disassembly is not canonical\n", file);
+            ok = false;
+        }
+    }
+
+    size_t name_len = strlen(file);
+    if(ok && name_len > 2 && strcmp(file + name_len - 2, ".s") == 0) {
+        char *mc_file = malloc(name_len + 2);
+        sprintf(mc_file, "%.*s.mc", (int)(name_len - 2), file);
+        FILE *probe = fopen(mc_file, "r");
+        if(probe) {
+            fclose(probe);
+            uint32_t *words;
+            int64_t count;
+            ok = ReadMachineFile(mc_file, false, &words, &count);
+            int64_t pc = ok ? FirstDifference(program.code, program.code_count, words, count) : -1;
+            if(pc >= 0) {
+                ReportDifference(file, mc_file, program.code, program.code_count, words, count, pc);
+                ok = false;
+            }
+            free(words);
+        }
+        free(mc_file);
+    }
+
+    if(ok)
+        printf("%s: %lld words ok\n", file, (long long)program.code_count);
+    free(text);
+    free(text_again);
+    AsmProgramFree(&program);
+    AsmProgramFree(&again);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    bool raw = false;
+    bool verify = false;
+    const char *out_file = NULL;
+    const char **files = malloc(sizeof(char*) * argc);
+    int file_count = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--raw") == 0)
+            raw = true;
+        else if(strcmp(argv[i], "--verify") == 0)
+            verify = true;
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            out_file = argv[++i];
+        else
+            files[file_count++] = argv[i];
+    }
+    if(file_count == 0 || (!verify && file_count > 1)) {
+        fprintf(stderr, "Usage: %s [--raw] <file.mc> [-o file.s]\n"
+                        "       %s --verify <file.s> ...\n", argv[0], argv[0]);
+        free(files);
+        return 1;
+    }
+
+    int status = 0;
+    if(verify) {
+        int passed = 0;
+        for(int i = 0; i < file_count; i++)
+            passed += Verify(files[i]);
+        printf("verify: %d/%d files ok\n", passed, file_count);
+        status = passed == file_count ? 0 : 1;
+    } else {
+        uint32_t *words;
+        int64_t count;
+        char *text = NULL;
+        size_t len = 0;
+        if(!ReadMachineFile(files[0], raw, &words, &count)) {
+            // nothing (or a partial read) to list: leave the output alone
+            free(words);
+            free(files);
+            return 1;
+        }
+        if(!DisassembleWords(words, count, &text, &len))
+            status = 1; // still written, w/ the bad words as comments
+        FILE *out = out_file ? fopen(out_file, "w") : stdout;
+        if(!out) {
+            fprintf(stderr, "Error: Cannot open %s\n", out_file);
+            status = 1;
+        } else {
+            fwrite(text, 1, len, out);
+            if(out != stdout)
+                fclose(out);
+        }
+        free(text);
+        free(words);
+    }
+    free(files);
+    return status;
+}
\ No newline at end of file
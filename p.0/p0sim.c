@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assembler.h"
+#include "simulator.h"
+
+// p0sim: assemble a .s and run it in the simulator
+//   p0sim file.s [--stats]
+// the program's output goes to stdout, --stats counts to stderr
+int main(int argc, char **argv) {
+    const char *in_file = NULL;
+    int stats_wanted = 0;
+    int usage = 0;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--stats") == 0)
+            stats_wanted = 1;
+        else if(!in_file)
+            in_file = argv[i];
+        else
+            usage = 1;
+    }
+    if(!in_file || usage) {
+        fprintf(stderr, "Usage: %s <file.s> [--stats]\n", argv[0]);
+        return 1;
+    }
+
+    AsmProgram program;
+    if(!AssembleFile(in_file, 1, &program)) {
+        AsmProgramFree(&program);
+        return 1;
+    }
+    OutputCapture output;
+    SimStats stats;
+    capture_init(&output);
+    int status = Simulate(&program, &output, &stats) ? 0 : 1;
+    fwrite(capture_get(&output), 1, output.size, stdout);
+    if(stats_wanted)
+        PrintSimStats(&stats, stderr);
+    SimStatsFree(&stats);
+    capture_free(&output);
+    AsmProgramFree(&program);
+    return status;
+}
\ No newline at end of file
@@ -8,6 +8,10 @@
 #include "assembly.h"
 #include "machine_code.h"
 #include "interpreter.h"
+#include "x86_64.h"
+#include "c_source.h"
+#include "simulator.h"
+#include "pipeline.h"
 
 #define NODE_PRINT_PART 7
 #define NODE_STR_ASSIGN 8 
@@ -25,6 +29,7 @@ Semantics sem_analyzer;
 extern int yylex();
 extern int yyparse();
 extern FILE *yyin;
+extern int stmt_line, stmt_column; // lexer.l: start of the current statement
 void yyerror(const char *s);
 int yylex_destroy(void);
 
@@ -565,40 +570,136 @@ int check_content_after_end_delimiter(const char *filename) {
     return has_error ? 1 : 0;
 }
 
+// the program's output, the same whichever back end ran it
+static void PrintProgramOutput(const char *output) {
+    if(output && strlen(output) > 0)
+        printf("%s\n", output);
+    else
+        printf("(No output produced)\n");
+}
+
 int main(int argc, char **argv) {
-    if(argc < 2) {
-        fprintf(stderr, "Usage: %s <input_file> [output_file]\n", argv[0]);
+    // options (-Os, ...) may appear anywhere; the rest are positional
+    char *args[2] = {NULL, NULL};
+    int arg_count = 0;
+    int write_asm = 1; // .s is only a printed view of the IR now
+    int write_map = 0; // --line-map: .p0map (source line of each word) next to the .mc
+    int target_x86 = 0; // --target=x86_64: native executable instead of .s/.mc
+    int emit_c = 0; // --emit=c: C source instead of .s/.mc
+    int run_cc = 0; // --cc: build that w/ gcc and run it (instead of the interpreter)
+    MachineFormat mc_format = MC_FORMAT_TEXT; // --mc-format=
+    int run_sim = 0; // --sim: run the machine code in the simulator (instead of the interpreter)
+    int sim_check = 0; // --sim-check: that, and compare its output w/ the interpreter's
+    int sim_stats = 0; // --sim-stats: that, w/ instruction counts on stderr
+    int sim_failed = 0;
+    int cc_failed = 0; // (--cc) gcc or the program it built failed
+    int pipeline_report = 0; // --pipeline-report[=spec]: estimated cycles/stalls on stderr
+    PipelineModel pipeline = default_pipeline;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-Os") == 0) {
+            AssemblySetOutlining(true); // outline repeated instruction sequences
+        } else if(strncmp(argv[i], "--target=", 9) == 0) {
+            if(strcmp(argv[i] + 9, "x86_64") == 0) {
+                target_x86 = 1;
+            } else if(strcmp(argv[i] + 9, "mips64") != 0) {
+                fprintf(stderr, "Error: unknown target %s (mips64, x86_64)\n", argv[i] + 9);
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--emit=c") == 0) {
+            emit_c = 1;
+        } else if(strcmp(argv[i], "--cc") == 0) {
+            emit_c = run_cc = 1;
+        } else if(strncmp(argv[i], "--mc-format=", 12) == 0) {
+            if(!ParseMachineFormat(argv[i] + 12, &mc_format)) {
+                fprintf(stderr, "Error: unknown machine code format %s (text, raw, ihex, elf)\n", argv[i] + 12);
+                return 1;
+            }
+        } else if(strcmp(argv[i], "--sim") == 0) {
+            run_sim = 1;
+        } else if(strcmp(argv[i], "--sim-check") == 0) {
+            run_sim = sim_check = 1;
+        } else if(strcmp(argv[i], "--sim-stats") == 0) {
+            run_sim = sim_stats = 1;
+        } else if(strcmp(argv[i], "--pipeline-report") == 0) {
+            pipeline_report = 1;
+        } else if(strncmp(argv[i], "--pipeline-report=", 18) == 0) {
+            if(!ParsePipelineModel(argv[i] + 18, &pipeline)) {
+                fprintf(stderr, "Error: bad pipeline model %s (e.g. forwarding=off,ld=2,dmult=5,ddiv=10,hilo=1,branch=1)\n", argv[i] + 18);
+                return 1;
+            }
+            pipeline_report = 1;
+        } else if(strcmp(argv[i], "--no-asm") == 0) {
+            write_asm = 0;
+        } else if(strcmp(argv[i], "--line-map") == 0) {
+            write_map = 1;
+        } else if(strcmp(argv[i], "--line-comments") == 0) {
+            AssemblySetLineComments(true); // ; line N:C in the .s
+        } else if(strcmp(argv[i], "--no-peephole") == 0) {
+            AssemblySetPeephole(false, false);
+        } else if(strcmp(argv[i], "--peephole-stats") == 0) {
+            AssemblySetPeephole(true, true);
+        } else if(strcmp(argv[i], "--buffered-output") == 0) {
+            AssemblySetBufferedOutput(true); // one syscall per output buffer
+        } else if(strcmp(argv[i], "--no-schedule") == 0) {
+            AssemblySetScheduling(false, NULL);
+        } else if(strncmp(argv[i], "--latency=", 10) == 0) {
+            LatencyModel model = default_latency;
+            if(!ParseLatencyModel(argv[i] + 10, &model)) {
+                fprintf(stderr, "Error: bad latency model %s (e.g. ld=2,dmult=5,ddiv=10,syscall=barrier)\n", argv[i] + 10);
+                return 1;
+            }
+            AssemblySetScheduling(true, &model);
+        } else if(strncmp(argv[i], "--jobs=", 7) == 0 || strncmp(argv[i], "-j", 2) == 0) {
+            const char *count = argv[i] + (argv[i][1] == 'j' ? 2 : 7);
+            char *end;
+            long jobs = strtol(count, &end, 10);
+            if(end == count || *end || jobs < 1) {
+                fprintf(stderr, "Error: bad job count %s\n", count);
+                return 1;
+            }
+            AssemblySetJobs((int)jobs); // codegen threads
+        } else if(arg_count < 2) {
+            args[arg_count++] = argv[i];
+        }
+    }
+
+    if(arg_count < 1) {
+        fprintf(stderr, "Usage: %s [-Os] [--no-asm] [--line-map] [--line-comments] [--no-peephole] [--peephole-stats] [--no-schedule] [--latency=spec] [--buffered-output] [--jobs=N] [--mc-format=text|raw|ihex|elf] [--target=mips64|x86_64] [--emit=c] [--cc] [--sim] [--sim-check] [--sim-stats] [--pipeline-report[=spec]] <input_file> [output_file]\n", argv[0]);
         return 1;
     }
 
     int error_count = 0;
+    AsmProgram sim_program; // (--sim) built while the IR is still there
+    int sim_ready = 0;
 
     char *asm_filename = "MIPS64.s";
-    char *machine_filename = "MACHINE_CODE.mc";
+    const char *machine_ext = MachineFormatExtension(mc_format); // .mc, .bin, .hex or .elf
+    char *machine_filename;
+    char *map_filename = "MACHINE_CODE.p0map";
     
-    if(argc >= 3) {
-        asm_filename = argv[2];
+    if(arg_count >= 2) {
+        asm_filename = args[1];
         // create machine code filename from assembly filename
         char *dot = strrchr(asm_filename, '.');
-        if(dot && strcmp(dot, ".s") == 0) {
-            // replace .s with .mc
-            strcpy(dot, ".mc");
-            machine_filename = asm_filename;
-            strcpy(dot, ".s"); // restore .s
-        } else {
-            // append .mc
-            machine_filename = malloc(strlen(asm_filename) + 4);
-            sprintf(machine_filename, "%s.mc", asm_filename);
-        }
+        int stem = dot && strcmp(dot, ".s") == 0 ? (int)(dot - asm_filename) : (int)strlen(asm_filename);
+        // replace .s w/ the extension, or append it (in a copy: the .s name is still needed)
+        machine_filename = malloc(stem + strlen(machine_ext) + 1);
+        sprintf(machine_filename, "%.*s%s", stem, asm_filename, machine_ext);
+        // source-line table next to it: x.mc -> x.p0map
+        map_filename = malloc(stem + 7);
+        sprintf(map_filename, "%.*s.p0map", stem, asm_filename);
+    } else {
+        machine_filename = malloc(strlen("MACHINE_CODE") + strlen(machine_ext) + 1);
+        sprintf(machine_filename, "MACHINE_CODE%s", machine_ext);
     }
     
     // initialize semantic analyzer
     sem_init(&sem_analyzer);
     sem_set_line(&sem_analyzer, 1);
     
-    yyin = fopen(argv[1], "r");
+    yyin = fopen(args[0], "r");
     if(!yyin) {
-        fprintf(stderr, "Error: Cannot open file %s\n", argv[1]);
+        fprintf(stderr, "Error: Cannot open file %s\n", args[0]);
         sem_cleanup(&sem_analyzer);
         return 1;
     }
@@ -622,7 +723,7 @@ int main(int argc, char **argv) {
     
 
     // FIX 18: Check for content AFTER <<< (LAST)
-    int after_error = check_content_after_end_delimiter(argv[1]);
+    int after_error = check_content_after_end_delimiter(args[0]);
     
     // TOTAL errors
     int total_errors = error_count + after_error;
@@ -637,56 +738,117 @@ int main(int argc, char **argv) {
         //print_ast(ast_root, 0);
         //printf("\n\n");
         
-        // open output file for assembly
-        FILE *asm_file = fopen(asm_filename, "w");
-        if(!asm_file) {
-            fprintf(stderr, "Error: Cannot open assembly file %s\n", asm_filename);
-            fclose(yyin);
-            sem_cleanup(&sem_analyzer);
-            free_node(ast_root);
-            return 1;
+        if(target_x86) {
+            // native executable (output file: a.out unless given)
+            const char *exe_filename = arg_count >= 2 ? args[1] : "a.out";
+            if(!GenerateX86Executable(ast_root, exe_filename))
+                fprintf(stderr, "Error: Cannot write executable %s\n", exe_filename);
+            write_asm = 0;
         }
         
-        // generate MIPS64 assembly
-        GenerateAssemblyProgram(ast_root, asm_file);
-        fclose(asm_file);
+        const char *c_filename = arg_count >= 2 ? args[1] : "program.c";
+        if(emit_c) {
+            if(!GenerateCSource(ast_root, c_filename)) {
+                fprintf(stderr, "Error: Cannot open C file %s\n", c_filename);
+                run_cc = 0;
+            }
+            write_asm = 0;
+        }
         
-        //printf("MIPS64 assembly written to %s\n", asm_filename);
+        // open output file for assembly
+        FILE *asm_file = NULL;
+        if(write_asm) {
+            asm_file = fopen(asm_filename, "w");
+            if(!asm_file) {
+                fprintf(stderr, "Error: Cannot open assembly file %s\n", asm_filename);
+                fclose(yyin);
+                sem_cleanup(&sem_analyzer);
+                free_node(ast_root);
+                return 1;
+            }
+        }
         
-        // now convert assembly to machine code
-        //printf("\nConverting assembly to machine code\n");
-        if(MachineFromAssembly(asm_filename, machine_filename)) {
-            //printf("Machine code written to %s\n", machine_filename);
+        // lower to MIPS64 (IR), writing the .s view if asked for
+        if(!target_x86 && !emit_c) {
+            GenerateAssemblyProgram(ast_root, asm_file);
+            if(asm_file)
+                fclose(asm_file);
             
-            // display machine code
-            //printf("\nMachine Code\n");
-            //FILE *mc_file = fopen(machine_filename, "r");
-            //if(mc_file) {
-            //    char line[256];
-            //    while(fgets(line, sizeof(line), mc_file)) {
-            //        printf("%s", line);
-            //    }
-            //    fclose(mc_file);
-           // }
-        } else {
-            //fprintf(stderr, "Error converting assembly to machine code\n");
+            //printf("MIPS64 assembly written to %s\n", asm_filename);
+            
+            // encode the IR straight to machine code (no .s re-parse)
+            int written;
+            if(mc_format == MC_FORMAT_TEXT) {
+                written = MachineFromInstructions(AssemblyInstructions(), machine_filename);
+            } else {
+                size_t data_len;
+                const char *data_text = AssemblyDataText(&data_len);
+                written = MachineImageFromInstructions(AssemblyInstructions(), data_text, data_len, mc_format, machine_filename);
+            }
+            if(!written) {
+                fprintf(stderr, "Error: Cannot write machine code file %s\n", machine_filename);
+                error_count++; // (exit status 1)
+            }
+            // the words + .data image, for the simulator
+            if(run_sim) {
+                size_t data_len;
+                const char *data_text = AssemblyDataText(&data_len);
+                if(ProgramFromInstructions(AssemblyInstructions(), data_text, data_len, &sim_program))
+                    sim_ready = 1;
+                else
+                    AsmProgramFree(&sim_program);
+            }
+            // what it costs on an in-order 5-stage pipeline
+            if(pipeline_report)
+                PrintPipelineReport(AssemblyInstructions(), &pipeline, args[0], stderr);
+            // which source line each word of it came from
+            if(write_map && !LineMapFromInstructions(AssemblyInstructions(), args[0], map_filename)) {
+                fprintf(stderr, "Error: Cannot open line map file %s\n", map_filename);
+            }
+            AssemblyFree();
         }
         
         // FIX 18
-        //int after_errors = check_content_after_end_delimiter(argv[1]);
+        //int after_errors = check_content_after_end_delimiter(args[0]);
         //total_errors += after_errors;
         ////
 
         // now interpret the program and display output
+        // (--cc: the gcc-built program prints it instead)
         //printf("\nProgram Output\n");
-        char *output = interpret_program(ast_root);
-        if(output && strlen(output) > 0) {
-            printf("%s\n", output);
-            
+        if(run_cc) {
+            OutputCapture cc_output;
+            capture_init(&cc_output);
+            cc_failed = !CompileAndRunCSource(c_filename, &cc_output);
+            if(!cc_failed || cc_output.size > 0) // (nothing ran if gcc failed)
+                PrintProgramOutput(capture_get(&cc_output));
+            capture_free(&cc_output);
+        } else if(sim_ready) {
+            // (--sim) the machine code itself prints it
+            OutputCapture sim_output;
+            SimStats stats;
+            capture_init(&sim_output);
+            sim_failed = !Simulate(&sim_program, &sim_output, &stats);
+            const char *output = capture_get(&sim_output);
+            PrintProgramOutput(output);
+            if(sim_stats)
+                PrintSimStats(&stats, stderr);
+            if(sim_check) {
+                char *expected = interpret_program(ast_root);
+                if(sim_failed || strcmp(expected ? expected : "", output) != 0) {
+                    fprintf(stderr, "sim: output differs from the interpreter's\n");
+                    sim_failed = 1;
+                }
+                free(expected);
+            }
+            SimStatsFree(&stats);
+            capture_free(&sim_output);
+            AsmProgramFree(&sim_program);
         } else {
-            printf("(No output produced)\n");
+            char *output = interpret_program(ast_root);
+            PrintProgramOutput(output);
+            free(output);
         }
-        free(output);
         
     } else {
         printf("\nCompilation failed with %d error(s)\n", total_errors);
@@ -697,7 +859,7 @@ int main(int argc, char **argv) {
     sem_cleanup(&sem_analyzer);
     free_node(ast_root);
     
-    return (parse_result != 0 || error_count > 0) ? 1 : 0;
+    return (parse_result != 0 || error_count > 0 || sim_failed || cc_failed) ? 1 : 0;
 }
 void yyerror(const char *s) {
     //fprintf(stderr, "Syntax error at line %d: %s\n", sem_analyzer.current_line, s);
@@ -706,23 +868,27 @@ void yyerror(const char *s) {
 
 // AST Creation Functions
 Node *create_num_node(int val) {
-    Node *node = malloc(sizeof(Node));
+    //Node *node = malloc(sizeof(Node));
+    Node *node = calloc(1, sizeof(Node)); // list.next must read NULL when walked as a list
     node->node_type = 0;
     node->int_val = val;
     return node;
 }
 
 Node *create_str_node(char *str) {
-    Node *node = malloc(sizeof(Node));
+    //Node *node = malloc(sizeof(Node));
+    Node *node = calloc(1, sizeof(Node)); // list.next must read NULL when walked as a list
     node->node_type = 1;
     node->str_val = strdup(str);
     return node;
 }
 
 Node *create_id_node(char *name) {
-    Node *node = malloc(sizeof(Node));
+    //Node *node = malloc(sizeof(Node));
+    Node *node = calloc(1, sizeof(Node)); // list.next must read NULL when walked as a list
     node->node_type = 2;
     node->str_val = strdup(name);
+    node->sym = -1;
     return node;
 }
 
@@ -744,6 +910,8 @@ Node *create_decl_node(Node *items) {
     node->node_type = 4;
     node->list.items = items;
     node->list.next = NULL;
+    node->line = stmt_line;
+    node->column = stmt_column;
     return node;
 }
 
@@ -753,6 +921,8 @@ Node *create_assign_node(Node *items) {
     node->node_type = 5;
     node->list.items = items;
     node->list.next = NULL;
+    node->line = stmt_line;
+    node->column = stmt_column;
     return node;
 }
 
@@ -761,6 +931,8 @@ Node *create_print_node(Node *parts) {
     Node *node = calloc(1, sizeof(Node));
     node->node_type = 6;
     node->print_stmt.parts = parts;
+    node->line = stmt_line;
+    node->column = stmt_column;
     return node;
 }
 
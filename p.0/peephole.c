@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "peephole.h"
+
+// how far (in live instructions) a rule may look ahead of its anchor
+#define PEEP_WINDOW 8
+// safety net, every rule strictly shrinks or simplifies the code
+#define PEEP_MAX_PASSES 64
+
+// tombstone for deleted instructions, compacted away after each pass
+#define OPC_DEAD OPC_COUNT
+
+// syscall argument register (print int/string)
+#define REG_ARG 4
+
+// liveness bits: r1..r31, then LO and HI
+#define LIVE_LO (1ULL << 32)
+#define LIVE_HI (1ULL << 33)
+#define LIVE_ALL (~0ULL)
+
+// buffer being rewritten
+static Instruction *peep_code = NULL;
+static int peep_count = 0;
+
+// registers live after each instruction: computed in full once per pass,
+// then patched backwards from the instructions a rule rewrote
+static uint64_t *live_after = NULL;
+static bool live_dirty = true;
+// range rewritten since live_after was last brought up to date (hi < 0: none)
+static int rewritten_lo = 0;
+static int rewritten_hi = -1;
+
+static uint64_t RegBit(int reg) {
+    return reg ? 1ULL << reg : 0; // r0 is never live
+}
+
+// registers (and LO/HI) read by an instruction; control transfers read everything
+static uint64_t Uses(const Instruction *ins) {
+    switch(ins->op) {
+        case OPC_DADDIU:
+        case OPC_LD:
+            return RegBit(ins->rs);
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_DMULT:
+        case OPC_DDIV:
+            return RegBit(ins->rs) | RegBit(ins->rt);
+        case OPC_MFLO:
+            return LIVE_LO;
+        case OPC_MFHI:
+            return LIVE_HI;
+        case OPC_SD:
+            return RegBit(ins->rd) | RegBit(ins->rs);
+        case OPC_SYSCALL:
+            return RegBit(REG_ARG);
+        default:
+            return LIVE_ALL;
+    }
+}
+
+static uint64_t Defs(const Instruction *ins) {
+    switch(ins->op) {
+        case OPC_DADDIU:
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_MFLO:
+        case OPC_MFHI:
+        case OPC_LD:
+            return RegBit(ins->rd);
+        case OPC_DMULT:
+        case OPC_DDIV:
+            return LIVE_LO | LIVE_HI;
+        default:
+            return 0;
+    }
+}
+
+static bool IsBarrier(const Instruction *ins) {
+    return Uses(ins) == LIVE_ALL;
+}
+
+static bool FitsImmediate(long long v) {
+    return v >= INT16_MIN && v <= INT16_MAX;
+}
+
+static void MarkRewritten(int i) {
+    if(rewritten_hi < 0) {
+        rewritten_lo = rewritten_hi = i;
+    } else {
+        if(i < rewritten_lo)
+            rewritten_lo = i;
+        if(i > rewritten_hi)
+            rewritten_hi = i;
+    }
+}
+
+// live_after[] from instruction `from` down; below the rewritten range it
+// stops as soon as a value comes out the same (nothing earlier changed)
+static void UpdateLiveness(int from, int lo) {
+    uint64_t live = 0;
+    if(from + 1 < peep_count) {
+        const Instruction *next = &peep_code[from + 1];
+        live = live_after[from + 1];
+        if(next->op != OPC_DEAD)
+            live = (live & ~Defs(next)) | Uses(next);
+    }
+    for(int k = from; k >= 0; k--) {
+        if(k < lo && live_after[k] == live)
+            break;
+        live_after[k] = live;
+        if(peep_code[k].op == OPC_DEAD)
+            continue;
+        live = (live & ~Defs(&peep_code[k])) | Uses(&peep_code[k]);
+    }
+}
+
+// nothing is live once the program falls off the end
+static uint64_t LiveAfter(int i) {
+    if(live_dirty) {
+        UpdateLiveness(peep_count - 1, 0);
+        live_dirty = false;
+    } else if(rewritten_hi >= 0) {
+        UpdateLiveness(rewritten_hi, rewritten_lo);
+    }
+    rewritten_hi = -1;
+    return live_after[i];
+}
+
+static int NextLive(int i) {
+    for(i++; i < peep_count && peep_code[i].op == OPC_DEAD; i++);
+    return i;
+}
+
+static void Kill(int i) {
+    peep_code[i].op = OPC_DEAD;
+    MarkRewritten(i);
+}
+
+// rewrite instruction i into daddu rd, src, r0 (or drop it if rd == src)
+static void RewriteToCopy(int i, int rd, int src) {
+    if(rd == src) {
+        Kill(i);
+        return;
+    }
+    Instruction copy = { .op = OPC_DADDU, .rd = rd, .rs = src, .rt = 0, .sym = -1, .imm = 0,
+                         .line = peep_code[i].line, .column = peep_code[i].column };
+    peep_code[i] = copy;
+    MarkRewritten(i);
+}
+
+// daddu rX, rX, r0 | daddu rX, r0, rX | dsubu rX, rX, r0 | daddiu rX, rX, #0
+static bool SelfMove(int i) {
+    Instruction *ins = &peep_code[i];
+    bool self = false;
+    if(ins->op == OPC_DADDU)
+        self = (ins->rd == ins->rs && ins->rt == 0) || (ins->rd == ins->rt && ins->rs == 0);
+    else if(ins->op == OPC_DSUBU)
+        self = ins->rd == ins->rs && ins->rt == 0;
+    else if(ins->op == OPC_DADDIU)
+        self = ins->rd == ins->rs && ins->sym < 0 && ins->imm == 0;
+    if(self)
+        Kill(i);
+    return self;
+}
+
+// sd rA, x(r0) ... ld rB, x(r0)  =>  sd rA, x(r0) ... daddu rB, rA, r0
+// (ld rA, x(r0) ... ld rB, x(r0) is the same rule w/ the first ld as source)
+static bool ForwardMemory(int i) {
+    Instruction *src = &peep_code[i];
+    if(src->rs != 0)
+        return false;
+    int value = src->rd;
+    int j = i;
+    for(int seen = 0; seen < PEEP_WINDOW; seen++) {
+        j = NextLive(j);
+        if(j >= peep_count)
+            return false;
+        Instruction *ins = &peep_code[j];
+        if(IsBarrier(ins))
+            return false;
+        if(ins->op == OPC_SD && (ins->sym == src->sym || ins->rs != 0))
+            return false; // x may have changed
+        if(ins->op == OPC_LD && ins->sym == src->sym && ins->rs == 0) {
+            RewriteToCopy(j, ins->rd, value);
+            return true;
+        }
+        if(Defs(ins) & RegBit(value))
+            return false;
+    }
+    return false;
+}
+
+// daddiu rT, r0, #k (or daddu rT, r0, r0) ... op rD, rX, rT  =>  daddiu rD, rX, #+-k
+// the constant def goes away through dead-def once its last use is folded
+static bool ImmediateFold(int i) {
+    Instruction *def = &peep_code[i];
+    long long k;
+    if(def->op == OPC_DADDIU && def->rs == 0 && def->sym < 0)
+        k = def->imm;
+    else if(def->op == OPC_DADDU && def->rs == 0 && def->rt == 0)
+        k = 0;
+    else
+        return false;
+    int t = def->rd;
+    if(t == 0 || !FitsImmediate(k))
+        return false;
+
+    int j = i;
+    for(int seen = 0; seen < PEEP_WINDOW; seen++) {
+        j = NextLive(j);
+        if(j >= peep_count)
+            return false;
+        Instruction *ins = &peep_code[j];
+        if(IsBarrier(ins))
+            return false;
+        int other = -1;
+        long long imm = 0;
+        if(ins->op == OPC_DADDU && (ins->rs == t || ins->rt == t)) {
+            other = ins->rs == t ? ins->rt : ins->rs;
+            imm = k;
+            if(other == t) { // rT + rT
+                other = 0;
+                imm = 2 * k;
+            }
+        } else if(ins->op == OPC_DSUBU && ins->rt == t && ins->rs != t) {
+            other = ins->rs;
+            imm = -k;
+        } else if(ins->op == OPC_DADDIU && ins->rs == t && ins->sym < 0) {
+            other = 0;
+            imm = k + ins->imm;
+        }
+        if(other >= 0 && FitsImmediate(imm)) {
+            Instruction folded = { .op = OPC_DADDIU, .rd = ins->rd, .rs = other, .rt = 0, .sym = -1, .imm = imm,
+                                   .line = ins->line, .column = ins->column };
+            *ins = folded;
+            MarkRewritten(j);
+            return true;
+        }
+        if(Defs(ins) & RegBit(t))
+            return false;
+    }
+    return false;
+}
+
+// op rT, ... ; daddu rD, rT, r0  (rT dead after)  =>  op rD, ...
+// mostly mflo into a temp that is then copied into the variable's register
+static bool CopyCoalesce(int i) {
+    int t = peep_code[i].rd;
+    int j = NextLive(i);
+    if(t == 0 || j >= peep_count)
+        return false;
+    Instruction *copy = &peep_code[j];
+    if(copy->op != OPC_DADDU)
+        return false;
+    int dest;
+    if(copy->rs == t && copy->rt == 0)
+        dest = copy->rd;
+    else if(copy->rt == t && copy->rs == 0)
+        dest = copy->rd;
+    else
+        return false;
+    if(dest == 0 || dest == t || (LiveAfter(j) & RegBit(t)))
+        return false;
+    peep_code[i].rd = dest;
+    MarkRewritten(i);
+    Kill(j);
+    return true;
+}
+
+// result (register or LO/HI) overwritten or never read
+static bool DeadDef(int i) {
+    uint64_t defs = Defs(&peep_code[i]);
+    if(!defs || (LiveAfter(i) & defs))
+        return false;
+    Kill(i);
+    return true;
+}
+
+typedef struct {
+    const char *name;
+    uint32_t anchors; // opcodes the rule can start at
+    bool (*apply)(int i);
+    long hits;
+} PeepholeRule;
+
+#define ON(op) (1u << (op))
+#define DEF_OPS (ON(OPC_DADDIU) | ON(OPC_DADDU) | ON(OPC_DSUBU) | ON(OPC_LD) | ON(OPC_MFLO) | ON(OPC_MFHI))
+
+// tried in order at every instruction
+static PeepholeRule rules[] = {
+    { "self-move",      ON(OPC_DADDU) | ON(OPC_DSUBU) | ON(OPC_DADDIU), SelfMove,      0 },
+    { "store-forward",  ON(OPC_SD),                                     ForwardMemory, 0 },
+    { "redundant-load", ON(OPC_LD),                                     ForwardMemory, 0 },
+    { "imm-fold",       ON(OPC_DADDIU) | ON(OPC_DADDU),                 ImmediateFold, 0 },
+    { "copy-coalesce",  DEF_OPS,                                        CopyCoalesce,  0 },
+    { "dead-mflo",      ON(OPC_MFLO) | ON(OPC_MFHI),                    DeadDef,       0 },
+    { "dead-hilo",      ON(OPC_DMULT) | ON(OPC_DDIV),                   DeadDef,       0 },
+    { "dead-def",       ON(OPC_DADDIU) | ON(OPC_DADDU) | ON(OPC_DSUBU) | ON(OPC_LD), DeadDef, 0 },
+};
+
+#define RULE_COUNT ((int)(sizeof(rules) / sizeof(rules[0])))
+
+static void Compact() {
+    int out = 0;
+    for(int i = 0; i < peep_count; i++) {
+        if(peep_code[i].op != OPC_DEAD)
+            peep_code[out++] = peep_code[i];
+    }
+    peep_count = out;
+}
+
+int PeepholeOptimize(InstrBuffer *buf) {
+    for(int r = 0; r < RULE_COUNT; r++)
+        rules[r].hits = 0;
+    if(buf->count == 0)
+        return 0;
+
+    peep_code = buf->code;
+    peep_count = buf->count;
+    live_after = malloc(sizeof(uint64_t) * peep_count);
+
+    int total = 0;
+    for(int pass = 0; pass < PEEP_MAX_PASSES; pass++) {
+        int hits = 0;
+        live_dirty = true;
+        for(int i = 0; i < peep_count; i++) {
+            for(int r = 0; r < RULE_COUNT; r++) {
+                uint8_t op = peep_code[i].op;
+                if(op == OPC_DEAD)
+                    break;
+                if(!(rules[r].anchors & ON(op)))
+                    continue;
+                if(rules[r].apply(i)) {
+                    rules[r].hits++;
+                    hits++;
+                }
+            }
+        }
+        Compact();
+        total += hits;
+        if(hits == 0)
+            break; // fixpoint
+    }
+
+    buf->count = peep_count;
+    free(live_after);
+    live_after = NULL;
+    peep_code = NULL;
+    peep_count = 0;
+    return total;
+}
+
+void PeepholePrintStats(FILE *out) {
+    fprintf(out, "peephole rule hits:\n");
+    for(int r = 0; r < RULE_COUNT; r++)
+        fprintf(out, "  %-16s %ld\n", rules[r].name, rules[r].hits);
+}
\ No newline at end of file
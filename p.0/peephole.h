@@ -0,0 +1,14 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+#include "instruction.h"
+
+// sliding-window peephole pass over the straight-line IR (run b4 outlining)
+// rules from a table are applied until none fires; returns total rewrites
+int PeepholeOptimize(InstrBuffer *buf);
+
+// per-rule hit counters of the last run
+void PeepholePrintStats(FILE *out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "pipeline.h"
+
+#define REG_ARG 4
+#define REG_RA 31
+
+const PipelineModel default_pipeline = { true, 2, 5, 10, 1, 1 };
+
+bool ParsePipelineModel(const char *spec, PipelineModel *model) {
+    char *copy = strdup(spec);
+    bool ok = true;
+    for(char *item = strtok(copy, ","); item && ok; item = strtok(NULL, ",")) {
+        char *eq = strchr(item, '=');
+        if(!eq) {
+            ok = false;
+            break;
+        }
+        *eq = '\0';
+        const char *value = eq + 1;
+        if(strcmp(item, "forwarding") == 0) {
+            if(strcmp(value, "on") == 0)
+                model->forwarding = true;
+            else if(strcmp(value, "off") == 0)
+                model->forwarding = false;
+            else
+                ok = false;
+            continue;
+        }
+        char *end;
+        long cycles = strtol(value, &end, 10);
+        if(end == value || *end || cycles > 1000000 ||
+           cycles < (strcmp(item, "branch") == 0 ? 0 : 1)) // (branch=0: perfect prediction)
+            ok = false;
+        else if(strcmp(item, "branch") == 0)
+            model->branch = cycles;
+        else if(strcmp(item, "ld") == 0)
+            model->ld = cycles;
+        else if(strcmp(item, "dmult") == 0)
+            model->dmult = cycles;
+        else if(strcmp(item, "ddiv") == 0)
+            model->ddiv = cycles;
+        else if(strcmp(item, "hilo") == 0)
+            model->hilo = cycles;
+        else
+            ok = false;
+    }
+    free(copy);
+    return ok;
+}
+
+typedef enum {
+    STALL_LOAD, // reads a ld/lbu result
+    STALL_ALU, // reads an alu result (w/o forwarding)
+    STALL_DMULT, // mflo/mfhi waits for dmult
+    STALL_DDIV, // mflo/mfhi waits for ddiv
+    STALL_HILO, // reads a mflo/mfhi result
+    STALL_MD_BUSY, // dmult/ddiv while the previous one is still going
+    STALL_BRANCH, // taken jump/branch
+    STALL_CAUSE_COUNT
+} StallCause;
+
+static const char *cause_names[STALL_CAUSE_COUNT] = {
+    "load-use", "alu", "dmult", "ddiv", "mflo/mfhi use", "md busy", "branch",
+};
+
+// registers the model tracks: r0-r31 (r0 never stalls), then lo and hi
+#define PIPE_LO 32
+#define PIPE_HI 33
+#define PIPE_REGS 34
+
+// registers an instruction reads; count returned
+// (unlike ReadSet in scheduler.c this covers every op, runtime ones too)
+static int PipeReads(const Instruction *ins, int regs[3]) {
+    int n = 0;
+    switch(ins->op) {
+        case OPC_DADDU: case OPC_DSUBU: case OPC_SLT: case OPC_DMULT: case OPC_DDIV:
+        case OPC_BEQ: case OPC_BNE:
+            regs[n++] = ins->rs;
+            regs[n++] = ins->rt;
+            break;
+        case OPC_DADDIU: case OPC_LD: case OPC_LBU: case OPC_DSLL: case OPC_DSRA:
+        case OPC_DSLL32: case OPC_ORI: case OPC_JR:
+            regs[n++] = ins->rs;
+            break;
+        case OPC_SD: case OPC_SB:
+            regs[n++] = ins->rd; // the value stored
+            regs[n++] = ins->rs;
+            break;
+        case OPC_MFLO:
+            regs[n++] = PIPE_LO;
+            break;
+        case OPC_MFHI:
+            regs[n++] = PIPE_HI;
+            break;
+        case OPC_SYSCALL:
+            regs[n++] = REG_ARG;
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+// the register an instruction writes (dmult/ddiv: lo and hi), -1 if none
+static int PipeWrite(const Instruction *ins) {
+    switch(ins->op) {
+        case OPC_DADDIU: case OPC_DADDU: case OPC_DSUBU: case OPC_SLT: case OPC_DSLL:
+        case OPC_DSRA: case OPC_DSLL32: case OPC_LUI: case OPC_ORI: case OPC_LD:
+        case OPC_LBU: case OPC_MFLO: case OPC_MFHI:
+            return ins->rd;
+        case OPC_JAL:
+            return REG_RA;
+        default:
+            return -1;
+    }
+}
+
+typedef struct {
+    int line;
+    int64_t stalls;
+    int64_t instructions;
+} LineCost;
+
+static int CompareLineCost(const void *a, const void *b) {
+    const LineCost *x = a, *y = b;
+    if(x->stalls != y->stalls)
+        return x->stalls < y->stalls ? 1 : -1;
+    return x->line - y->line;
+}
+
+// source lines 1..max_line (NULL where the file is shorter or unreadable)
+static char** ReadSourceLines(const char *source, int max_line) {
+    FILE *f = source ? fopen(source, "r") : NULL;
+    if(!f)
+        return NULL;
+    char **lines = calloc(max_line + 1, sizeof(char*));
+    char *text = NULL;
+    size_t size = 0;
+    ssize_t len;
+    for(int line = 1; line <= max_line && (len = getline(&text, &size, f)) >= 0; line++) {
+        while(len > 0 && (text[len - 1] == '\n' || text[len - 1] == '\r'))
+            text[--len] = '\0';
+        const char *start = text + strspn(text, " \t");
+        lines[line] = strndup(start, 48);
+    }
+    free(text);
+    fclose(f);
+    return lines;
+}
+
+#define WORST_LINES 10
+
+void PrintPipelineReport(const InstrBuffer *code, const PipelineModel *model, const char *source, FILE *out) {
+    // label id -> instruction index (branch direction)
+    int label_max = -1, max_line = 0;
+    for(int i = 0; i < code->count; i++) {
+        if(code->code[i].op == OPC_LABEL && code->code[i].imm > label_max)
+            label_max = (int)code->code[i].imm;
+        if(code->code[i].line > max_line)
+            max_line = code->code[i].line;
+    }
+    int *label_index = malloc(sizeof(int) * (label_max + 2));
+    for(int i = 0; i < code->count; i++) {
+        if(code->code[i].op == OPC_LABEL)
+            label_index[code->code[i].imm] = i;
+    }
+
+    // w/o forwarding a result is read from the register file after WB:
+    // alu/mflo/mfhi results are 2 stages (EX -> WB) later, loads 1 (MEM -> WB)
+    int extra_alu = model->forwarding ? 0 : 2;
+    int extra_ld = model->forwarding ? 0 : 1;
+
+    int64_t ready[PIPE_REGS] = { 0 }; // first cycle a reader may issue in
+    uint8_t ready_cause[PIPE_REGS] = { 0 };
+    int64_t md_free = 0; // the multiply/divide unit isn't pipelined
+    int64_t cycle = 0; // issue cycle of the previous instruction
+    int64_t instructions = 0;
+    int64_t stalls[STALL_CAUSE_COUNT] = { 0 };
+    LineCost *lines = calloc(max_line + 1, sizeof(LineCost));
+
+    for(int i = 0; i < code->count; i++) {
+        const Instruction *ins = &code->code[i];
+        if(ins->op == OPC_LABEL) {
+            // reached from elsewhere too: nothing in flight is known
+            memset(ready, 0, sizeof(ready));
+            md_free = 0;
+            continue;
+        }
+        int64_t issue = cycle + 1;
+        int cause = -1;
+        int regs[3];
+        int n = PipeReads(ins, regs);
+        for(int k = 0; k < n; k++) {
+            if(regs[k] != 0 && ready[regs[k]] > issue) {
+                issue = ready[regs[k]];
+                cause = ready_cause[regs[k]];
+            }
+        }
+        if((ins->op == OPC_DMULT || ins->op == OPC_DDIV) && md_free > issue) {
+            issue = md_free;
+            cause = STALL_MD_BUSY;
+        }
+        int64_t stall = issue - (cycle + 1);
+        if(stall > 0)
+            stalls[cause] += stall;
+
+        int dest = PipeWrite(ins);
+        if(ins->op == OPC_DMULT || ins->op == OPC_DDIV) {
+            int latency = ins->op == OPC_DMULT ? model->dmult : model->ddiv;
+            md_free = ready[PIPE_LO] = ready[PIPE_HI] = issue + latency;
+            ready_cause[PIPE_LO] = ready_cause[PIPE_HI] = ins->op == OPC_DMULT ? STALL_DMULT : STALL_DDIV;
+        } else if(dest > 0) {
+            if(ins->op == OPC_LD || ins->op == OPC_LBU) {
+                ready[dest] = issue + model->ld + extra_ld;
+                ready_cause[dest] = STALL_LOAD;
+            } else if(ins->op == OPC_MFLO || ins->op == OPC_MFHI) {
+                ready[dest] = issue + model->hilo + extra_alu;
+                ready_cause[dest] = STALL_HILO;
+            } else {
+                ready[dest] = issue + 1 + extra_alu;
+                ready_cause[dest] = STALL_ALU;
+            }
+        }
+        cycle = issue;
+        instructions++;
+
+        // jumps, and branches predicted taken (backward: loops), refetch
+        bool taken = ins->op == OPC_J || ins->op == OPC_JAL || ins->op == OPC_JR ||
+                     ((ins->op == OPC_BEQ || ins->op == OPC_BNE) && label_index[ins->imm] <= i);
+        if(taken) {
+            stalls[STALL_BRANCH] += model->branch;
+            stall += model->branch;
+            cycle += model->branch;
+        }
+        if(taken || ins->op == OPC_HALT) {
+            // what follows runs after some other code (or never)
+            memset(ready, 0, sizeof(ready));
+            md_free = 0;
+        }
+        lines[ins->line].line = ins->line;
+        lines[ins->line].stalls += stall;
+        lines[ins->line].instructions++;
+    }
+
+    int64_t total_stalls = 0;
+    for(int c = 0; c < STALL_CAUSE_COUNT; c++)
+        total_stalls += stalls[c];
+    int64_t cycles = cycle + (instructions > 0 ? 4 : 0); // + draining MEM/WB
+    fprintf(out, "pipeline: forwarding %s, ld %d, dmult %d, ddiv %d, hilo %d, branch %d\n",
+            model->forwarding ? "on" : "off", model->ld, model->dmult, model->ddiv, model->hilo, model->branch);
+    fprintf(out, "  %-16s %lld\n", "instructions", (long long)instructions);
+    fprintf(out, "  %-16s %lld (CPI %.2f)\n", "cycles", (long long)cycles,
+            instructions > 0 ? (double)cycles / instructions : 0.0);
+    fprintf(out, "  %-16s %lld\n", "stall cycles", (long long)total_stalls);
+    for(int c = 0; c < STALL_CAUSE_COUNT; c++) {
+        if(stalls[c] > 0)
+            fprintf(out, "    %-14s %lld\n", cause_names[c], (long long)stalls[c]);
+    }
+
+    // worst source lines (line 0: runtime routines, halt, final flush)
+    qsort(lines, max_line + 1, sizeof(LineCost), CompareLineCost);
+    char **text = ReadSourceLines(source, max_line);
+    if(max_line >= 0 && lines[0].stalls > 0)
+        fprintf(out, "  worst lines (stall cycles / instructions):\n");
+    for(int k = 0; k < WORST_LINES && k <= max_line && lines[k].stalls > 0; k++) {
+        const LineCost *cost = &lines[k];
+        if(cost->line == 0)
+            fprintf(out, "    %-6s %6lld / %-6lld (runtime)\n", "-", (long long)cost->stalls, (long long)cost->instructions);
+        else
+            fprintf(out, "    %-6d %6lld / %-6lld %s\n", cost->line, (long long)cost->stalls, (long long)cost->instructions,
+                    text && text[cost->line] ? text[cost->line] : "");
+    }
+    if(text) {
+        for(int line = 0; line <= max_line; line++)
+            free(text[line]);
+        free(text);
+    }
+    free(lines);
+    free(label_index);
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "instruction.h"
+
+// cost model of an in-order 5-stage pipeline (IF ID EX MEM WB) for the
+// final instruction stream; latencies are cycles until a result can be
+// used w/o stalling (1 = next instruction), as in LatencyModel
+typedef struct {
+    bool forwarding; // off: results wait for WB (alu/hilo + 2, ld + 1)
+    int ld; // load-use
+    int dmult; // dmult -> mflo/mfhi, and the unit is busy that long
+    int ddiv; // ddiv -> mflo/mfhi, same
+    int hilo; // mflo/mfhi -> use
+    int branch; // cycles lost per taken jump/branch
+} PipelineModel;
+
+extern const PipelineModel default_pipeline;
+
+// "forwarding=on|off,ld=2,dmult=5,ddiv=10,hilo=1,branch=1"; false on a bad spec
+bool ParsePipelineModel(const char *spec, PipelineModel *model);
+
+// static estimate: every instruction issues once, in program order;
+// hazards carry over fallthrough only (labels and jumps start w/ an empty
+// pipeline), branches are predicted backward taken / forward not taken
+// prints cycles, stall cycles by cause and the source lines w/ the most
+// stalls (source: the file to quote them from, or NULL)
+void PrintPipelineReport(const InstrBuffer *code, const PipelineModel *model, const char *source, FILE *out);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "regalloc.h"
+#include "symbol_table.h"
+
+// registers handed to variables
+// r4 = syscall arg, r10-r19 = expression temps, r28-r31 = gp/sp/fp/ra
+static const int var_regs[] = { 5, 6, 7, 8, 9, 20, 21, 22, 23, 24, 25, 26, 27 };
+#define VAR_REG_COUNT ((int)(sizeof(var_regs) / sizeof(var_regs[0])))
+
+// live interval of one variable, in statement indices
+typedef struct {
+    int sym; // symbol id
+    int start; // first statement touching the var
+    int end; // last statement touching the var
+    int uses; // reads + writes
+    bool read_first; // first access is a read -> register must start at 0
+    int reg; // 0 = spilled (memory)
+} Interval;
+
+static Interval *intervals = NULL;
+static int interval_count = 0;
+static int interval_capacity = 0;
+
+// symbol id -> its interval (-1: none yet), while the statements are walked
+static int *interval_of = NULL;
+
+// record one access of var `id` (a NODE_ID) at statement `index`
+static void Touch(Node *id, int index, bool is_write) {
+    if(id->sym < 0 || IsStringSymbolId(id->sym))
+        return;
+    Interval *it = interval_of[id->sym] >= 0 ? &intervals[interval_of[id->sym]] : NULL;
+    if(!it) {
+        if(interval_count >= interval_capacity) {
+            interval_capacity = interval_capacity ? interval_capacity * 2 : 32;
+            intervals = realloc(intervals, sizeof(Interval) * interval_capacity);
+        }
+        interval_of[id->sym] = interval_count;
+        it = &intervals[interval_count++];
+        it->sym = id->sym;
+        it->start = index;
+        it->end = index;
+        it->uses = 0;
+        it->read_first = !is_write;
+        it->reg = 0;
+    }
+    it->end = index;
+    it->uses++;
+}
+
+// reads inside an expression
+static void TouchExpression(Node *node, int index) {
+    if(!node)
+        return;
+    switch(node->node_type) {
+        case 2: // NODE_ID
+            Touch(node, index, false);
+            break;
+        case 3: // NODE_BINOP
+            TouchExpression(node->binop.left, index);
+            TouchExpression(node->binop.right, index);
+            break;
+        case 7: // NODE_PRINT_PART
+            TouchExpression(node->list.items, index);
+            break;
+    }
+}
+
+// accesses of one statement; rhs is read b4 the lhs is written
+static void TouchStatement(Node *node, int index) {
+    switch(node->node_type) {
+        case 4: // NODE_DECL
+        case 5: { // NODE_ASSIGN
+            // one item per statement; plain "int x" is not an access
+            // (x reads 0 until written, see read_first)
+            Node *item = node->list.items;
+            if(item && item->node_type == 3 && item->binop.op == '=') {
+                TouchExpression(item->binop.right, index);
+                if(item->binop.left && item->binop.left->node_type == 2)
+                    Touch(item->binop.left, index, true);
+            }
+            break;
+        }
+        case 6: // NODE_PRINT
+            for(Node *part = node->print_stmt.parts; part; part = part->list.next) {
+                Node *content = part->node_type == 7 ? part->list.items : part;
+                if(content && content->node_type != 1)
+                    TouchExpression(content, index);
+            }
+            break;
+    }
+}
+
+// higher = more worth keeping in a register
+static double SpillWeight(const Interval *it) {
+    return (double)it->uses / (double)(it->end - it->start + 1);
+}
+
+static int CompareStart(const void *a, const void *b) {
+    const Interval *x = a, *y = b;
+    if(x->start != y->start)
+        return x->start - y->start;
+    return y->uses - x->uses;
+}
+
+void RegAllocFree() {
+    free(intervals);
+    intervals = NULL;
+    interval_count = interval_capacity = 0;
+}
+
+// Poletto-Sarkar style linear scan
+// intervals are visited by start; expired ones free their register (an
+// interval ending at statement s is still live in s, so end < start is
+// required). when no register is free, whichever of the active intervals or
+// the new one has the lowest uses/length weight is spilled to memory
+void AllocateVariableRegisters(Node *program) {
+    RegAllocFree();
+
+    interval_of = malloc(sizeof(int) * (SymbolCount() + 1));
+    for(int i = 0; i < SymbolCount(); i++)
+        interval_of[i] = -1;
+    int index = 0;
+    for(Node *stmt = program; stmt; stmt = stmt->list.next)
+        TouchStatement(stmt, index++);
+    free(interval_of);
+    interval_of = NULL;
+
+    qsort(intervals, interval_count, sizeof(Interval), CompareStart);
+
+    Interval **active = malloc(sizeof(Interval*) * VAR_REG_COUNT);
+    int active_count = 0;
+    bool reg_busy[32] = {false};
+
+    for(int i = 0; i < interval_count; i++) {
+        Interval *cur = &intervals[i];
+
+        // expire old intervals
+        for(int a = 0; a < active_count; ) {
+            if(active[a]->end < cur->start) {
+                reg_busy[active[a]->reg] = false;
+                active[a] = active[--active_count];
+            } else {
+                a++;
+            }
+        }
+
+        if(active_count < VAR_REG_COUNT) {
+            for(int r = 0; r < VAR_REG_COUNT; r++) {
+                if(!reg_busy[var_regs[r]]) {
+                    cur->reg = var_regs[r];
+                    break;
+                }
+            }
+            reg_busy[cur->reg] = true;
+            active[active_count++] = cur;
+            continue;
+        }
+
+        // all taken: spill the cheapest
+        int victim = -1;
+        double lowest = SpillWeight(cur);
+        for(int a = 0; a < active_count; a++) {
+            double w = SpillWeight(active[a]);
+            if(w < lowest) {
+                lowest = w;
+                victim = a;
+            }
+        }
+        if(victim < 0) {
+            cur->reg = 0; // new interval stays in memory
+            continue;
+        }
+        // NOTE: the victim goes to memory for its whole range, so code
+        // generated b4 this point is still consistent (nothing emitted yet)
+        cur->reg = active[victim]->reg;
+        active[victim]->reg = 0;
+        active[victim] = cur;
+    }
+    free(active);
+
+    for(int i = 0; i < interval_count; i++)
+        SetRegisterOfSymbolId(intervals[i].sym, intervals[i].reg);
+}
+
+int ZeroInitRegisters(int index, int *regs, int max) {
+    // intervals are sorted by start: binary search the first one at index
+    int lo = 0, hi = interval_count;
+    while(lo < hi) {
+        int mid = (lo + hi) / 2;
+        if(intervals[mid].start < index)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    int n = 0;
+    for(int i = lo; i < interval_count && intervals[i].start == index && n < max; i++) {
+        if(intervals[i].read_first && intervals[i].reg > 0)
+            regs[n++] = intervals[i].reg;
+    }
+    return n;
+}
\ No newline at end of file
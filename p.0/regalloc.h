@@ -0,0 +1,17 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ast.h"
+
+// linear-scan allocation of int variables to registers over the program's
+// straight-line statement list; results go into the symbol table (reg > 0)
+// call after all symbols are collected
+void AllocateVariableRegisters(Node *program);
+
+// registers that must read 0 b4 statement `index` runs (var read b4 any write)
+// returns how many were written to regs
+int ZeroInitRegisters(int index, int *regs, int max);
+
+void RegAllocFree();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "runtime.h"
+#include "symbol_table.h"
+
+// routine scratch registers (never live across a print in generated code)
+#define RT_T0 1
+#define RT_T1 2
+#define RT_T2 3
+#define RT_SIGN 29
+#define REG_ARG 4
+#define REG_RA 31
+
+// signed division by 10: q = (mulhi(x, M) >> 2) + (x < 0)
+#define RECIP10_MAGIC 0x6666666666666667LL
+
+// .data labels, in the order they are laid out
+#define RT_DATA_OUTBUF 0
+#define RT_DATA_OUTBUF_END 1 // one past the buffer (room for the terminator)
+#define RT_DATA_ITOA 2 // digits are written backwards from _itoa_end
+#define RT_DATA_ITOA_END 3
+#define RT_DATA_RECIP10 4
+#define RT_DATA_COUNT 5
+
+static const struct {
+    const char *name;
+    int size;
+} rt_data[RT_DATA_COUNT] = {
+    [RT_DATA_OUTBUF]     = { "_outbuf",     RT_BUFFER_SIZE },
+    [RT_DATA_OUTBUF_END] = { "_outbuf_end", 8 },
+    [RT_DATA_ITOA]       = { "_itoa",       24 },
+    [RT_DATA_ITOA_END]   = { "_itoa_end",   8 },
+    [RT_DATA_RECIP10]    = { "_recip10",    8 },
+};
+
+static int data_sym[RT_DATA_COUNT];
+static int routine_label[RT_ROUTINES];
+// branch targets inside the routines
+static int putstr_loop, putstr_done, putint_loop, putint_copy;
+
+void RuntimeInit() {
+    for(int i = 0; i < RT_DATA_COUNT; i++)
+        data_sym[i] = AddLabel(rt_data[i].name, rt_data[i].size);
+    routine_label[RT_PUTSTR] = NewCodeLabel("_putstr");
+    routine_label[RT_PUTINT] = NewCodeLabel("_putint");
+    routine_label[RT_FLUSH] = NewCodeLabel("_flush");
+    putstr_loop = NewCodeLabel("_putstr_loop");
+    putstr_done = NewCodeLabel("_putstr_done");
+    putint_loop = NewCodeLabel("_putint_loop");
+    putint_copy = NewCodeLabel("_putint_copy");
+}
+
+int RuntimeRoutine(int routine) {
+    return routine_label[routine];
+}
+
+int RuntimeBufferSymbol() {
+    return data_sym[RT_DATA_OUTBUF];
+}
+
+void RuntimePrintData(FILE *out) {
+    for(int i = 0; i < RT_DATA_COUNT; i++) {
+        if(i == RT_DATA_RECIP10)
+            fprintf(out, "%s: .dword %lld\n", rt_data[i].name, RECIP10_MAGIC);
+        else
+            fprintf(out, "%s: .space %d\n", rt_data[i].name, rt_data[i].size);
+    }
+}
+
+static InstrBuffer *out_buf;
+
+static void Add(Opcode op, int rd, int rs, int rt, int sym, long long imm) {
+    Instruction ins = { .op = op, .rd = rd, .rs = rs, .rt = rt, .sym = sym, .imm = imm };
+    InstrAppend(out_buf, ins);
+}
+
+static void Label(int id) {
+    Add(OPC_LABEL, 0, 0, 0, -1, id);
+}
+
+// sb r0 at the cursor, syscall 5 on the buffer, cursor back to its start
+static void AddFlush() {
+    Add(OPC_SB, 0, RT_REG_CURSOR, 0, -1, 0);
+    Add(OPC_DADDIU, REG_ARG, 0, 0, data_sym[RT_DATA_OUTBUF], 0);
+    Add(OPC_SYSCALL, 0, 0, 0, -1, 5);
+    Add(OPC_DADDU, RT_REG_CURSOR, REG_ARG, 0, -1, 0);
+}
+
+void RuntimeAppendRoutines(InstrBuffer *buf) {
+    out_buf = buf;
+
+    // _putint: digits of -|x| (so INT64_MIN works too), least significant
+    // first, backwards from _itoa_end; then '-' and on into _putstr
+    Label(routine_label[RT_PUTINT]);
+    Add(OPC_DADDIU, RT_T1, 0, 0, data_sym[RT_DATA_ITOA_END], 0);
+    Add(OPC_SB, 0, RT_T1, 0, -1, 0);
+    Add(OPC_SLT, RT_SIGN, REG_ARG, 0, -1, 0);
+    Add(OPC_BNE, 0, RT_SIGN, 0, -1, putint_loop);
+    Add(OPC_DSUBU, REG_ARG, 0, REG_ARG, -1, 0);
+    Label(putint_loop);
+    Add(OPC_LD, RT_T2, 0, 0, data_sym[RT_DATA_RECIP10], 0);
+    Add(OPC_DMULT, 0, REG_ARG, RT_T2, -1, 0);
+    Add(OPC_MFHI, RT_T0, 0, 0, -1, 0);
+    Add(OPC_DSRA, RT_T0, RT_T0, 0, -1, 2);
+    Add(OPC_SLT, RT_T2, REG_ARG, 0, -1, 0);
+    Add(OPC_DADDU, RT_T0, RT_T0, RT_T2, -1, 0); // q = x / 10
+    Add(OPC_DSLL, RT_T2, RT_T0, 0, -1, 3);
+    Add(OPC_DSUBU, REG_ARG, REG_ARG, RT_T2, -1, 0);
+    Add(OPC_DSLL, RT_T2, RT_T0, 0, -1, 1);
+    Add(OPC_DSUBU, REG_ARG, REG_ARG, RT_T2, -1, 0); // x - 10q, in -9..0
+    Add(OPC_DADDIU, RT_T2, 0, 0, -1, '0');
+    Add(OPC_DSUBU, RT_T2, RT_T2, REG_ARG, -1, 0);
+    Add(OPC_DADDIU, RT_T1, RT_T1, 0, -1, -1);
+    Add(OPC_SB, RT_T2, RT_T1, 0, -1, 0);
+    Add(OPC_DADDU, REG_ARG, RT_T0, 0, -1, 0);
+    Add(OPC_BNE, 0, REG_ARG, 0, -1, putint_loop);
+    Add(OPC_BEQ, 0, RT_SIGN, 0, -1, putint_copy);
+    Add(OPC_DADDIU, RT_T2, 0, 0, -1, '-');
+    Add(OPC_DADDIU, RT_T1, RT_T1, 0, -1, -1);
+    Add(OPC_SB, RT_T2, RT_T1, 0, -1, 0);
+    Label(putint_copy);
+    Add(OPC_DADDU, REG_ARG, RT_T1, 0, -1, 0);
+
+    // _putstr: byte copy into the buffer, flushing whenever it fills up
+    Label(routine_label[RT_PUTSTR]);
+    Add(OPC_DADDU, RT_T1, REG_ARG, 0, -1, 0);
+    Label(putstr_loop);
+    Add(OPC_LBU, RT_T2, RT_T1, 0, -1, 0);
+    Add(OPC_BEQ, 0, RT_T2, 0, -1, putstr_done);
+    Add(OPC_SB, RT_T2, RT_REG_CURSOR, 0, -1, 0);
+    Add(OPC_DADDIU, RT_REG_CURSOR, RT_REG_CURSOR, 0, -1, 1);
+    Add(OPC_DADDIU, RT_T1, RT_T1, 0, -1, 1);
+    Add(OPC_DADDIU, RT_T0, 0, 0, data_sym[RT_DATA_OUTBUF_END], 0);
+    Add(OPC_BNE, 0, RT_REG_CURSOR, RT_T0, -1, putstr_loop);
+    AddFlush();
+    Add(OPC_J, 0, 0, 0, -1, putstr_loop);
+    Label(putstr_done);
+    Add(OPC_JR, 0, REG_RA, 0, -1, 0);
+
+    // _flush: end of program
+    Label(routine_label[RT_FLUSH]);
+    AddFlush();
+    Add(OPC_JR, 0, REG_RA, 0, -1, 0);
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdio.h>
+#include "instruction.h"
+
+// buffered output runtime (--buffered-output)
+// prints append to an output buffer in .data; only a full buffer and the
+// end of the program cost a syscall
+
+#define RT_PUTSTR 0 // copy the string at r4 into the buffer
+#define RT_PUTINT 1 // format r4 as decimal into the buffer
+#define RT_FLUSH 2 // print what is buffered
+#define RT_ROUTINES 3
+
+#define RT_BUFFER_SIZE 256
+
+// buffer cursor, kept in a register for the whole program
+// (r1, r2, r3, r29 and HI/LO are clobbered by the routines)
+#define RT_REG_CURSOR 30
+
+// registers the data labels and code labels; call after the vars are in the
+// symbol table (data offsets follow .data order)
+void RuntimeInit();
+int RuntimeRoutine(int routine); // code label id for jal
+int RuntimeBufferSymbol(); // _outbuf
+void RuntimePrintData(FILE *out);
+// append the routines (after halt and any outlined subroutines)
+void RuntimeAppendRoutines(InstrBuffer *buf);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "scheduler.h"
+
+// syscall argument register (print int/string)
+#define REG_ARG 4
+
+// dependency resources: r0..r31, LO, HI, print order, then one per memory symbol
+#define RES_LO 32
+#define RES_HI 33
+#define RES_IO 34
+#define RES_MEM 35
+
+const LatencyModel default_latency = {
+    .alu = 1,
+    .ld = 2,
+    .dmult = 5,
+    .ddiv = 10,
+    .syscall_barrier = false,
+};
+
+typedef struct {
+    int to;
+    int latency;
+} Edge;
+
+typedef struct {
+    Edge *succ;
+    int succ_count;
+    int succ_capacity;
+    int preds_left;
+    int earliest; // first cycle it can issue w/o stalling
+    int height; // latency-weighted path to the end of the program
+} SchedNode;
+
+// per resource: last writer and readers since then
+typedef struct {
+    int last_def;
+    int *readers;
+    int reader_count;
+    int reader_capacity;
+} Resource;
+
+static SchedNode *nodes = NULL;
+
+static void AddEdge(int from, int to, int latency) {
+    if(from < 0 || from == to)
+        return;
+    SchedNode *n = &nodes[from];
+    if(n->succ_count >= n->succ_capacity) {
+        n->succ_capacity = n->succ_capacity ? n->succ_capacity * 2 : 4;
+        n->succ = realloc(n->succ, sizeof(Edge) * n->succ_capacity);
+    }
+    n->succ[n->succ_count].to = to;
+    n->succ[n->succ_count].latency = latency;
+    n->succ_count++;
+    nodes[to].preds_left++;
+}
+
+static int ResultLatency(const Instruction *ins, const LatencyModel *model) {
+    switch(ins->op) {
+        case OPC_LD:
+            return model->ld;
+        case OPC_DMULT:
+            return model->dmult;
+        case OPC_DDIV:
+            return model->ddiv;
+        default:
+            return model->alu;
+    }
+}
+
+static bool IsBarrier(const Instruction *ins, const LatencyModel *model) {
+    switch(ins->op) {
+        case OPC_LABEL:
+        case OPC_JAL:
+        case OPC_JR:
+        case OPC_HALT:
+            return true;
+        case OPC_SYSCALL:
+            return model->syscall_barrier;
+        case OPC_SD:
+            return ins->rs != 0; // unknown address, may alias any slot
+        case OPC_DADDIU:
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_DMULT:
+        case OPC_DDIV:
+        case OPC_MFLO:
+        case OPC_MFHI:
+        case OPC_LD:
+        case OPC_LUI:
+        case OPC_ORI:
+        case OPC_DSLL:
+        case OPC_DSLL32:
+            return false;
+        default:
+            return true; // runtime/branch code is never reordered
+    }
+}
+
+// resources read and written by an instruction (r0 never creates a dependency)
+static int ReadSet(const Instruction *ins, int *res) {
+    int n = 0;
+    switch(ins->op) {
+        case OPC_DADDIU:
+        case OPC_ORI:
+        case OPC_DSLL:
+        case OPC_DSLL32:
+            res[n++] = ins->rs;
+            break;
+        case OPC_LD:
+            res[n++] = ins->rs;
+            res[n++] = RES_MEM + ins->sym;
+            break;
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_DMULT:
+        case OPC_DDIV:
+            res[n++] = ins->rs;
+            res[n++] = ins->rt;
+            break;
+        case OPC_MFLO:
+            res[n++] = RES_LO;
+            break;
+        case OPC_MFHI:
+            res[n++] = RES_HI;
+            break;
+        case OPC_SD:
+            res[n++] = ins->rd;
+            res[n++] = ins->rs;
+            break;
+        case OPC_SYSCALL:
+            res[n++] = REG_ARG;
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+static int WriteSet(const Instruction *ins, int *res) {
+    int n = 0;
+    switch(ins->op) {
+        case OPC_DADDIU:
+        case OPC_DADDU:
+        case OPC_DSUBU:
+        case OPC_MFLO:
+        case OPC_MFHI:
+        case OPC_LD:
+        case OPC_LUI:
+        case OPC_ORI:
+        case OPC_DSLL:
+        case OPC_DSLL32:
+            res[n++] = ins->rd;
+            break;
+        case OPC_DMULT:
+        case OPC_DDIV:
+            res[n++] = RES_LO;
+            res[n++] = RES_HI;
+            break;
+        case OPC_SD:
+            res[n++] = RES_MEM + ins->sym;
+            break;
+        case OPC_SYSCALL:
+            res[n++] = RES_IO; // prints stay in order
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+// RAW edges carry the producer's latency, WAR/WAW only keep the order
+static void BuildDag(const Instruction *code, int n, const LatencyModel *model, Resource *res) {
+    int region_start = 0; // first instruction after the last barrier
+    int last_barrier = -1;
+    for(int i = 0; i < n; i++) {
+        const Instruction *ins = &code[i];
+        AddEdge(last_barrier, i, 1);
+        if(IsBarrier(ins, model)) {
+            for(int k = region_start; k < i; k++)
+                AddEdge(k, i, ResultLatency(&code[k], model));
+            region_start = i + 1;
+            last_barrier = i;
+        }
+
+        int reads[4], writes[4];
+        int nr = ReadSet(ins, reads);
+        int nw = WriteSet(ins, writes);
+        for(int k = 0; k < nr; k++) {
+            if(reads[k] == 0)
+                continue;
+            Resource *r = &res[reads[k]];
+            if(r->last_def >= 0)
+                AddEdge(r->last_def, i, ResultLatency(&code[r->last_def], model));
+            if(r->reader_count >= r->reader_capacity) {
+                r->reader_capacity = r->reader_capacity ? r->reader_capacity * 2 : 8;
+                r->readers = realloc(r->readers, sizeof(int) * r->reader_capacity);
+            }
+            r->readers[r->reader_count++] = i;
+        }
+        for(int k = 0; k < nw; k++) {
+            if(writes[k] == 0)
+                continue;
+            Resource *r = &res[writes[k]];
+            for(int j = 0; j < r->reader_count; j++)
+                AddEdge(r->readers[j], i, 1);
+            AddEdge(r->last_def, i, 1);
+            r->last_def = i;
+            r->reader_count = 0;
+        }
+    }
+}
+
+// cycles the given order needs under the model (single issue, in order)
+static long OrderCycles(const int *order, int n) {
+    int *issue = malloc(sizeof(int) * n);
+    int *ready_at = calloc(n, sizeof(int));
+    long cycle = -1;
+    for(int k = 0; k < n; k++) {
+        int i = order[k];
+        cycle = cycle + 1 > ready_at[i] ? cycle + 1 : ready_at[i];
+        issue[i] = cycle;
+        for(int e = 0; e < nodes[i].succ_count; e++) {
+            Edge *edge = &nodes[i].succ[e];
+            if(issue[i] + edge->latency > ready_at[edge->to])
+                ready_at[edge->to] = issue[i] + edge->latency;
+        }
+    }
+    free(issue);
+    free(ready_at);
+    return cycle + 1;
+}
+
+int ScheduleInstructions(InstrBuffer *buf, const LatencyModel *model) {
+    int n = buf->count;
+    if(n < 2)
+        return 0;
+
+    int max_sym = -1;
+    for(int i = 0; i < n; i++) {
+        if(buf->code[i].sym > max_sym)
+            max_sym = buf->code[i].sym;
+    }
+    int res_count = RES_MEM + max_sym + 1;
+    Resource *res = calloc(res_count, sizeof(Resource));
+    for(int r = 0; r < res_count; r++)
+        res[r].last_def = -1;
+    nodes = calloc(n, sizeof(SchedNode));
+
+    BuildDag(buf->code, n, model, res);
+
+    // heights, edges only point forward so reverse order is topological
+    for(int i = n - 1; i >= 0; i--) {
+        int h = 1;
+        for(int e = 0; e < nodes[i].succ_count; e++) {
+            Edge *edge = &nodes[i].succ[e];
+            if(edge->latency + nodes[edge->to].height > h)
+                h = edge->latency + nodes[edge->to].height;
+        }
+        nodes[i].height = h;
+    }
+
+    int *original = malloc(sizeof(int) * n);
+    for(int i = 0; i < n; i++)
+        original[i] = i;
+    long before = OrderCycles(original, n);
+
+    // cycle-driven list scheduling: among ready instructions whose operands
+    // are available pick the tallest, ties in program order; stall if none
+    int *ready = malloc(sizeof(int) * n);
+    int ready_count = 0;
+    int *order = malloc(sizeof(int) * n);
+    int scheduled = 0;
+    for(int i = 0; i < n; i++) {
+        if(nodes[i].preds_left == 0)
+            ready[ready_count++] = i;
+    }
+    int cycle = 0;
+    while(scheduled < n) {
+        int best = -1, soonest = -1;
+        for(int k = 0; k < ready_count; k++) {
+            SchedNode *c = &nodes[ready[k]];
+            if(soonest < 0 || c->earliest < nodes[ready[soonest]].earliest)
+                soonest = k;
+            if(c->earliest > cycle)
+                continue;
+            if(best < 0 || c->height > nodes[ready[best]].height ||
+               (c->height == nodes[ready[best]].height && ready[k] < ready[best]))
+                best = k;
+        }
+        if(best < 0) {
+            cycle = nodes[ready[soonest]].earliest; // nothing hides the stall
+            continue;
+        }
+        int i = ready[best];
+        ready[best] = ready[--ready_count];
+        order[scheduled++] = i;
+        for(int e = 0; e < nodes[i].succ_count; e++) {
+            Edge *edge = &nodes[i].succ[e];
+            SchedNode *s = &nodes[edge->to];
+            if(cycle + edge->latency > s->earliest)
+                s->earliest = cycle + edge->latency;
+            if(--s->preds_left == 0)
+                ready[ready_count++] = edge->to;
+        }
+        cycle++;
+    }
+    long after = OrderCycles(order, n);
+
+    // greedy, so keep the original order if it was alr better
+    if(after < before) {
+        Instruction *scheduled_code = malloc(sizeof(Instruction) * buf->capacity);
+        for(int k = 0; k < n; k++)
+            scheduled_code[k] = buf->code[order[k]];
+        free(buf->code);
+        buf->code = scheduled_code;
+    } else {
+        after = before;
+    }
+
+    for(int i = 0; i < n; i++)
+        free(nodes[i].succ);
+    free(nodes);
+    nodes = NULL;
+    for(int r = 0; r < res_count; r++)
+        free(res[r].readers);
+    free(res);
+    free(original);
+    free(ready);
+    free(order);
+    return (int)(before - after);
+}
+
+bool ParseLatencyModel(const char *spec, LatencyModel *model) {
+    char *copy = strdup(spec);
+    bool ok = true;
+    for(char *item = strtok(copy, ","); item && ok; item = strtok(NULL, ",")) {
+        char *eq = strchr(item, '=');
+        if(!eq) {
+            ok = false;
+            break;
+        }
+        *eq = '\0';
+        const char *value = eq + 1;
+        if(strcmp(item, "syscall") == 0) {
+            if(strcmp(value, "barrier") == 0)
+                model->syscall_barrier = true;
+            else if(strcmp(value, "ordered") == 0)
+                model->syscall_barrier = false;
+            else
+                ok = false;
+            continue;
+        }
+        int cycles = atoi(value);
+        if(cycles < 1)
+            ok = false;
+        else if(strcmp(item, "alu") == 0)
+            model->alu = cycles;
+        else if(strcmp(item, "ld") == 0)
+            model->ld = cycles;
+        else if(strcmp(item, "dmult") == 0)
+            model->dmult = cycles;
+        else if(strcmp(item, "ddiv") == 0)
+            model->ddiv = cycles;
+        else
+            ok = false;
+    }
+    free(copy);
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdbool.h>
+#include "instruction.h"
+
+// cycles until a result can be used w/o stalling (1 = next instruction)
+typedef struct {
+    int alu;
+    int ld; // load-use
+    int dmult; // dmult -> mflo/mfhi
+    int ddiv; // ddiv -> mflo/mfhi
+    bool syscall_barrier; // nothing moves across a syscall
+} LatencyModel;
+
+// five-stage in-order pipeline defaults
+extern const LatencyModel default_latency;
+
+// "ld=2,dmult=5,ddiv=10,alu=1,syscall=barrier|ordered"; false on a bad spec
+bool ParseLatencyModel(const char *spec, LatencyModel *model);
+
+// list-schedule the straight-line program (b4 outlining) over its dependency
+// DAG: registers, LO/HI, memory slots and print order; returns estimated
+// stall cycles removed
+int ScheduleInstructions(InstrBuffer *buf, const LatencyModel *model);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "simulator.h"
+#include "disassembler.h"
+
+// taken jumps/branches before a run counts as hung (straight-line code
+// can't loop, only the runtime routines and jumps do)
+#define SIM_STEP_LIMIT 1000000000ULL
+
+// r0 reads 0: writes to it go to this extra register instead
+#define REG_SINK 32
+
+// one predecoded word (16 bytes): its handler, registers and the
+// immediate (branch, jump: target index; shifts: the full shift amount)
+typedef struct {
+    const void *handler;
+    int32_t imm;
+    uint8_t rd;
+    uint8_t rs;
+    uint8_t rt;
+    uint8_t op; // Opcode
+} MicroOp;
+
+static uint64_t LoadDword(const uint8_t *p) {
+    uint64_t v = 0;
+    for(int i = 0; i < 8; i++)
+        v = v << 8 | p[i];
+    return v;
+}
+
+static void StoreDword(uint8_t *p, uint64_t v) {
+    for(int i = 7; i >= 0; i--) {
+        p[i] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
+bool Simulate(const AsmProgram *program, OutputCapture *out, SimStats *stats) {
+    static const void *handlers[OPC_COUNT] = {
+        [OPC_DADDIU] = &&op_daddiu, [OPC_DADDU] = &&op_daddu, [OPC_DSUBU] = &&op_dsubu,
+        [OPC_DMULT] = &&op_dmult, [OPC_DDIV] = &&op_ddiv, [OPC_MFLO] = &&op_mflo,
+        [OPC_MFHI] = &&op_mfhi, [OPC_LD] = &&op_ld, [OPC_SD] = &&op_sd,
+        [OPC_SYSCALL] = &&op_syscall, [OPC_JAL] = &&op_jal, [OPC_JR] = &&op_jr,
+        [OPC_HALT] = &&op_halt, [OPC_LBU] = &&op_lbu, [OPC_SB] = &&op_sb,
+        [OPC_SLT] = &&op_slt, [OPC_DSLL] = &&op_dsll, [OPC_DSRA] = &&op_dsra,
+        [OPC_BEQ] = &&op_beq, [OPC_BNE] = &&op_bne, [OPC_J] = &&op_j,
+        [OPC_LUI] = &&op_lui, [OPC_ORI] = &&op_ori, [OPC_DSLL32] = &&op_dsll,
+    };
+
+    memset(stats, 0, sizeof(*stats));
+    int64_t count = program->code_count;
+    stats->code_count = count;
+    if(count >= INT32_MAX) {
+        fprintf(stderr, "Error: sim: too many words (%lld)\n", (long long)count);
+        return false;
+    }
+
+    // predecode; one extra op past the end stops the run like halt does
+    MicroOp *ops = calloc(count + 1, sizeof(MicroOp));
+    bool ok = true;
+    for(int64_t pc = 0; pc < count; pc++) {
+        Instruction ins;
+        MicroOp *uop = &ops[pc];
+        if(!DecodeWord(program->code[pc], pc, &ins)) {
+            fprintf(stderr, "Error: sim: word %lld (%08X) is not an instruction\n", (long long)pc, program->code[pc]);
+            ok = false;
+            continue;
+        }
+        uop->handler = handlers[ins.op];
+        uop->op = ins.op;
+        bool store = ins.op == OPC_SD || ins.op == OPC_SB; // rd: the value stored, read not written
+        uop->rd = ins.rd == 0 && !store ? REG_SINK : ins.rd;
+        uop->rs = ins.rs;
+        uop->rt = ins.rt;
+        uop->imm = (int32_t)(ins.op == OPC_DSLL32 ? ins.imm + 32 : ins.imm);
+        if((ins.op == OPC_JAL || ins.op == OPC_J || ins.op == OPC_BEQ || ins.op == OPC_BNE) &&
+           (ins.imm < 0 || ins.imm > count)) {
+            fprintf(stderr, "Error: sim: word %lld jumps outside .code\n", (long long)pc);
+            ok = false;
+        }
+    }
+    ops[count].handler = &&op_end;
+    ops[count].op = OPC_HALT;
+    if(!ok) {
+        free(ops);
+        return false;
+    }
+    // times each word ran (+ the end op)
+    uint64_t *counts = stats->by_pc = calloc(count + 1, sizeof(uint64_t));
+
+    uint8_t *mem = malloc(program->data_size + 1);
+    if(program->data_size > 0)
+        memcpy(mem, program->data, program->data_size);
+    uint64_t mem_size = program->data_size;
+    int64_t r[33] = { 0 };
+    int64_t hi = 0, lo = 0;
+    uint64_t steps = 0;
+    const char *trap = NULL;
+    MicroOp *ip = ops;
+    uint64_t address;
+
+#define DISPATCH() do { counts[ip - ops]++; goto *ip->handler; } while(0)
+#define NEXT() do { ip++; DISPATCH(); } while(0)
+#define JUMP(target) do { if(++steps > SIM_STEP_LIMIT) { trap = "step limit reached"; goto done; } \
+                          ip = ops + (target); DISPATCH(); } while(0)
+
+    DISPATCH();
+
+op_daddiu:
+    r[ip->rd] = (int64_t)((uint64_t)r[ip->rs] + (uint64_t)ip->imm);
+    NEXT();
+op_daddu:
+    r[ip->rd] = (int64_t)((uint64_t)r[ip->rs] + (uint64_t)r[ip->rt]);
+    NEXT();
+op_dsubu:
+    r[ip->rd] = (int64_t)((uint64_t)r[ip->rs] - (uint64_t)r[ip->rt]);
+    NEXT();
+op_dmult: {
+    __int128 product = (__int128)r[ip->rs] * r[ip->rt];
+    lo = (int64_t)product;
+    hi = (int64_t)(product >> 64);
+    NEXT();
+}
+op_ddiv:
+    if(r[ip->rt] == 0) {
+        lo = hi = 0; // (undefined on hardware; x / 0 is 0 on the other back ends)
+    } else if(r[ip->rs] == INT64_MIN && r[ip->rt] == -1) {
+        lo = INT64_MIN; // (overflows in C)
+        hi = 0;
+    } else {
+        lo = r[ip->rs] / r[ip->rt];
+        hi = r[ip->rs] % r[ip->rt];
+    }
+    NEXT();
+op_mflo:
+    r[ip->rd] = lo;
+    NEXT();
+op_mfhi:
+    r[ip->rd] = hi;
+    NEXT();
+op_ld:
+    address = (uint64_t)r[ip->rs] + (uint64_t)ip->imm;
+    if(address > mem_size || mem_size - address < 8)
+        goto bad_address;
+    r[ip->rd] = (int64_t)LoadDword(mem + address);
+    NEXT();
+op_sd:
+    address = (uint64_t)r[ip->rs] + (uint64_t)ip->imm;
+    if(address > mem_size || mem_size - address < 8)
+        goto bad_address;
+    StoreDword(mem + address, (uint64_t)r[ip->rd]);
+    NEXT();
+op_lbu:
+    address = (uint64_t)r[ip->rs] + (uint64_t)ip->imm;
+    if(address >= mem_size)
+        goto bad_address;
+    r[ip->rd] = mem[address];
+    NEXT();
+op_sb:
+    address = (uint64_t)r[ip->rs] + (uint64_t)ip->imm;
+    if(address >= mem_size)
+        goto bad_address;
+    mem[address] = (uint8_t)r[ip->rd];
+    NEXT();
+op_syscall:
+    if(ip->imm == 1) {
+        capture_printf(out, "%lld", (long long)r[4]);
+    } else if(ip->imm == 5) {
+        address = (uint64_t)r[4];
+        const uint8_t *end = address < mem_size ? memchr(mem + address, 0, mem_size - address) : NULL;
+        if(!end)
+            goto bad_address;
+        capture_write(out, (const char*)mem + address);
+    } else {
+        trap = "unknown syscall";
+        goto done;
+    }
+    NEXT();
+op_slt:
+    r[ip->rd] = r[ip->rs] < r[ip->rt];
+    NEXT();
+op_dsll:
+    r[ip->rd] = (int64_t)((uint64_t)r[ip->rs] << ip->imm);
+    NEXT();
+op_dsra:
+    r[ip->rd] = r[ip->rs] >> ip->imm;
+    NEXT();
+op_lui:
+    r[ip->rd] = (int64_t)(int32_t)((uint32_t)ip->imm << 16); // sign-extends
+    NEXT();
+op_ori:
+    r[ip->rd] = r[ip->rs] | ip->imm;
+    NEXT();
+op_beq:
+    if(r[ip->rs] == r[ip->rt])
+        JUMP(ip->imm);
+    NEXT();
+op_bne:
+    if(r[ip->rs] != r[ip->rt])
+        JUMP(ip->imm);
+    NEXT();
+op_j:
+    JUMP(ip->imm);
+op_jal:
+    r[31] = ip - ops + 1;
+    JUMP(ip->imm);
+op_jr:
+    if(r[ip->rs] < 0 || r[ip->rs] > count) {
+        trap = "jr outside .code";
+        goto done;
+    }
+    JUMP(r[ip->rs]);
+bad_address:
+    trap = ".data access out of range";
+    goto done;
+op_halt:
+op_end:
+done:
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+    if(trap) {
+        fprintf(stderr, "Error: sim: %s at word %lld\n", trap, (long long)(ip - ops));
+        ok = false;
+    }
+
+    for(int64_t pc = 0; pc < count; pc++) {
+        stats->by_op[ops[pc].op] += counts[pc];
+        stats->instructions += counts[pc];
+    }
+    free(mem);
+    free(ops);
+    return ok;
+}
+
+void SimStatsFree(SimStats *stats) {
+    free(stats->by_pc);
+    stats->by_pc = NULL;
+}
+
+void PrintSimStats(const SimStats *stats, FILE *out) {
+    fprintf(out, "sim: %llu instructions\n", (unsigned long long)stats->instructions);
+    for(int op = 0; op < OPC_COUNT; op++) {
+        if(stats->by_op[op] > 0)
+            fprintf(out, "  %-8s %llu\n", instr_info[op].mnemonic, (unsigned long long)stats->by_op[op]);
+    }
+}
\ No newline at end of file
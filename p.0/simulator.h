@@ -0,0 +1,35 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "assembler.h"
+#include "instruction.h"
+#include "output.h"
+
+// runs encoded .code words against the .data image: words are predecoded
+// (DecodeWord) into micro-ops once, then dispatched w/ computed gotos
+// code addresses are word indices (jal puts pc + 1 in r31), .data is
+// addressed from 0, loads/stores are big-endian like the image
+//   syscall 1: print r4 as a decimal int
+//   syscall 5: print the string r4 points at
+//   ddiv by 0: lo = hi = 0
+// it stops at halt or when pc runs off the end of .code
+
+typedef struct {
+    uint64_t instructions; // executed, halt included
+    uint64_t by_op[OPC_COUNT];
+    uint64_t *by_pc; // per .code word (malloc'd, SimStatsFree)
+    int64_t code_count;
+} SimStats;
+
+// program output goes to out; false (w/ a message on stderr) if a word
+// does not decode or the program traps (.data access out of range, jump
+// outside .code, over the step limit)
+bool Simulate(const AsmProgram *program, OutputCapture *out, SimStats *stats);
+void SimStatsFree(SimStats *stats);
+// instruction count, then executed counts per mnemonic
+void PrintSimStats(const SimStats *stats, FILE *out);
+
+#endif
\ No newline at end of file
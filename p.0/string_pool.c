@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "string_pool.h"
+#include "symbol_table.h"
+
+typedef struct {
+    char *label;
+    char *value;
+    size_t len;
+    size_t own; // bytes emitted under this label
+    bool terminated; // .asciiz, or .ascii when a shorter tail follows
+} StringEntry;
+
+static StringEntry *pool = NULL;
+static int pool_count = 0;
+static int pool_capacity = 0;
+
+// hash index: open addressing over pool indices (-1 = empty), at most half full
+static int *index_table = NULL;
+static int index_size = 0;
+
+// pool indices in .data order (set by StringPoolLayout)
+static int *layout = NULL;
+
+// FNV-1a
+static uint32_t HashText(const char *s) {
+    uint32_t h = 2166136261u;
+    for(; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// slot holding text, or the empty slot where it would go
+static int FindSlot(const char *text) {
+    uint32_t mask = index_size - 1;
+    uint32_t slot = HashText(text) & mask;
+    while(index_table[slot] >= 0 && strcmp(pool[index_table[slot]].value, text) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static void GrowIndex() {
+    free(index_table);
+    index_size = index_size ? index_size * 2 : 256;
+    index_table = malloc(sizeof(int) * index_size);
+    for(int i = 0; i < index_size; i++)
+        index_table[i] = -1;
+    for(int i = 0; i < pool_count; i++)
+        index_table[FindSlot(pool[i].value)] = i;
+}
+
+void StringPoolReset() {
+    for(int i = 0; i < pool_count; i++) {
+        free(pool[i].value);
+        free(pool[i].label);
+    }
+    pool_count = 0;
+    for(int i = 0; i < index_size; i++)
+        index_table[i] = -1;
+}
+
+const char* StringPoolIntern(char *text) {
+    if((pool_count + 1) * 2 > index_size)
+        GrowIndex();
+    int slot = FindSlot(text);
+    if(index_table[slot] >= 0) {
+        free(text);
+        return pool[index_table[slot]].label;
+    }
+
+    if(pool_count >= pool_capacity) {
+        pool_capacity = pool_capacity ? pool_capacity * 2 : 100;
+        pool = realloc(pool, sizeof(StringEntry) * pool_capacity);
+    }
+    StringEntry *s = &pool[pool_count];
+    s->value = text;
+    s->len = strlen(text);
+    s->own = s->len + 1;
+    s->terminated = true;
+    s->label = malloc(20);
+    sprintf(s->label, "str%d", pool_count);
+    index_table[slot] = pool_count;
+    pool_count++;
+    return s->label;
+}
+
+const char* StringPoolLabel(const char *text) {
+    if(index_size == 0)
+        return NULL;
+    int slot = FindSlot(text);
+    return index_table[slot] >= 0 ? pool[index_table[slot]].label : NULL;
+}
+
+int StringPoolCount() {
+    return pool_count;
+}
+
+// compare back to front: a string sorts right b4 the ones ending w/ it
+static int CompareReversed(const void *a, const void *b) {
+    const StringEntry *x = &pool[*(const int*)a];
+    const StringEntry *y = &pool[*(const int*)b];
+    size_t i = x->len, j = y->len;
+    while(i > 0 && j > 0) {
+        unsigned char cx = x->value[--i], cy = y->value[--j];
+        if(cx != cy)
+            return cx < cy ? -1 : 1;
+    }
+    return (i > 0) - (j > 0);
+}
+
+static bool IsSuffix(const StringEntry *tail, const StringEntry *s) {
+    return tail->len <= s->len && memcmp(s->value + s->len - tail->len, tail->value, tail->len) == 0;
+}
+
+void StringPoolLayout() {
+    free(layout);
+    layout = malloc(sizeof(int) * (pool_count + 1));
+    int *sorted = malloc(sizeof(int) * (pool_count + 1));
+    for(int i = 0; i < pool_count; i++)
+        sorted[i] = i;
+    qsort(sorted, pool_count, sizeof(int), CompareReversed);
+
+    // a run of sorted neighbours where each is a suffix of the next shares
+    // the bytes of the last (longest) one: emitted longest first, each label
+    // owning the bytes up to where the next shorter one starts
+    int n = 0;
+    for(int start = 0; start < pool_count; ) {
+        int end = start;
+        while(end + 1 < pool_count && IsSuffix(&pool[sorted[end]], &pool[sorted[end + 1]]))
+            end++;
+        for(int k = end; k >= start; k--) {
+            StringEntry *s = &pool[sorted[k]];
+            s->terminated = k == start;
+            s->own = s->terminated ? s->len + 1 : s->len - pool[sorted[k - 1]].len;
+            AddLabel(s->label, s->own);
+            layout[n++] = sorted[k];
+        }
+        start = end + 1;
+    }
+    free(sorted);
+}
+
+void StringPoolPrint(FILE *out) {
+    for(int k = 0; k < pool_count; k++) {
+        StringEntry *s = &pool[layout[k]];
+        size_t bytes = s->terminated ? s->len : s->own;
+        fprintf(out, "%s: %s \"", s->label, s->terminated ? ".asciiz" : ".ascii");
+        for(size_t i = 0; i < bytes; i++) {
+            char c = s->value[i];
+            if(c == '\n') fprintf(out, "\\n");
+            else if(c == '"') fprintf(out, "\\\"");
+            else if(c == '\\') fprintf(out, "\\\\");
+            else fputc(c, out);
+        }
+        fprintf(out, "\"\n");
+    }
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stdio.h>
+
+// string literals of the program (str0, str1, ...), de-duplicated through a
+// hash index; ch vars and prints point into it
+
+void StringPoolReset();
+// label for the (escape-processed) text, takes ownership of it
+const char* StringPoolIntern(char *text);
+// label of text if alr interned, else NULL (read-only: safe from codegen threads)
+const char* StringPoolLabel(const char *text);
+int StringPoolCount();
+
+// registers the labels in the symbol table in .data order; a literal that
+// is a suffix of another one gets no bytes of its own, its label points
+// into the tail of the longer one (tail merging)
+void StringPoolLayout();
+// the .data lines, in the order StringPoolLayout registered them
+void StringPoolPrint(FILE *out);
+
+#endif
\ No newline at end of file
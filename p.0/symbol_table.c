@@ -1,4 +1,5 @@
 #include <stdio.h>         
+#include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -8,46 +9,84 @@
 typedef struct {
     char name[MAX_NAME_LEN];
     int reg; // reg assigned (-1 for labels like str0, str1 that have no register)
-    uint64_t offset; // memory offset
-    bool is_string; // FIX 24
-    char *string_value; // FIX 24
-    size_t string_len; // FIX 24
+    uint64_t offset; // memory offset (final once LayoutDataSection ran)
+    uint64_t size;
+    bool slot; // 8-byte slot (var or spill), placed by use count
+    bool is_string; // ch var: 8-byte pointer into the string literals
+    bool has_init; // int var w/ a compile-time initial value (.dword)
+    int64_t init_value;
 } SymbolEntry;
 
-static SymbolEntry table[MAX_SYMBOLS];
+// grows as needed (no fixed symbol cap)
+static SymbolEntry *table = NULL;
 static int symbol_count = 0;
-static int next_reg = REG_MIN;
+static int symbol_capacity = 0;
 static uint64_t next_offset = 0x0;
 
-// print .data section with .space directives
-// only prits variables (those with reg != -1), str lables are habdled separately in assembly generator
-// void PrintDataSection(FILE *out) {
-//     for(int i = 0; i < symbol_count; i++) {
-//         if(table[i].reg != -1) {
-//             fprintf(out, "%s: .space 8\n", table[i].name);
-//         }
-//     }
-// }
-// FIX 24
+// hash index: open addressing over table indices (-1 = empty), at most
+// half full, so name -> id is one probe sequence instead of a table scan
+static int *index_table = NULL;
+static int index_size = 0;
+
+// slot ids in .data order (hot first), set by LayoutDataSection
+static int *slot_order = NULL;
+static int slot_count = 0;
+
+// FNV-1a (same as string_pool.c)
+static uint32_t HashName(const char *s) {
+    uint32_t h = 2166136261u;
+    for(; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// slot holding name, or the empty slot where it would go
+static int FindSlot(const char *name) {
+    uint32_t mask = index_size - 1;
+    uint32_t slot = HashName(name) & mask;
+    while(index_table[slot] >= 0 && strcmp(table[index_table[slot]].name, name) != 0)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+static void GrowIndex() {
+    free(index_table);
+    index_size = index_size ? index_size * 2 : 256;
+    index_table = malloc(sizeof(int) * index_size);
+    for(int i = 0; i < index_size; i++)
+        index_table[i] = -1;
+    for(int i = 0; i < symbol_count; i++)
+        index_table[FindSlot(table[i].name)] = i;
+}
+
+// make room for one more entry (table and index)
+static void GrowTable() {
+    if(symbol_count >= symbol_capacity) {
+        symbol_capacity = symbol_capacity ? symbol_capacity * 2 : MAX_SYMBOLS;
+        table = realloc(table, sizeof(SymbolEntry) * symbol_capacity);
+    }
+    if((symbol_count + 1) * 2 > index_size)
+        GrowIndex();
+}
+
+// index the entry just filled in at symbol_count
+static void IndexNewSymbol() {
+    index_table[FindSlot(table[symbol_count].name)] = symbol_count;
+}
+
+// print the 8-byte slots of .data (vars and spill slots) in layout order
+// labels (str0, str1, ..., runtime data) are printed by their owners, after these
 void PrintDataSection(FILE *out) {
-    for(int i = 0; i < symbol_count; i++) {
-        if(table[i].reg != -1) {
-            if(table[i].is_string && table[i].string_value) {
-                // ch or string var: use .asciiz
-                fprintf(out, "%s: .asciiz \"", table[i].name);
-                // escape special characters
-                for(const char *p = table[i].string_value; *p; p++) {
-                    if(*p == '\n') fprintf(out, "\\n");
-                    else if(*p == '\t') fprintf(out, "\\t");
-                    else if(*p == '"') fprintf(out, "\\\"");
-                    else if(*p == '\\') fprintf(out, "\\\\");
-                    else fputc(*p, out);
-                }
-                fprintf(out, "\"\n");
-            } else {
-                // int var: use .space 8
-                fprintf(out, "%s: .space 8\n", table[i].name);
-            }
+    for(int k = 0; k < slot_count; k++) {
+        SymbolEntry *e = &table[slot_order[k]];
+        if(e->has_init) {
+            // int var known at compile time: initialised in .data, no code
+            fprintf(out, "%s: .dword %lld\n", e->name, (long long)e->init_value);
+        } else {
+            // int var, ch pointer or spill slot: use .space 8
+            fprintf(out, "%s: .space 8\n", e->name);
         }
     }
 }
@@ -55,22 +94,17 @@ void PrintDataSection(FILE *out) {
 // initialize/reset symbol table
 void SymbolInit() {
     symbol_count = 0;
-    next_reg = REG_MIN;
+    for(int i = 0; i < index_size; i++)
+        index_table[i] = -1;
     next_offset = 0x0;
-    for(int i = 0; i < MAX_SYMBOLS; i++) {
-        table[i].name[0] = '\0';
-    }
+    slot_count = 0;
 }
 
 // get register assigned to symbol
+// 0 means the var lives in memory (not allocated or spilled by regalloc.c)
 // returns -1 if symbol is a label (like str0) or not found
 int GetRegisterOfTheSymbol(const char *name) {
-    for(int i = 0; i < symbol_count; i++) {
-        if(strcmp(table[i].name, name) == 0) {
-            return table[i].reg;
-        }
-    }
-    return -1;
+    return GetRegisterOfSymbolId(SymbolIndex(name));
 }
 
 // check if symbol exists (variable or label)
@@ -78,56 +112,69 @@ int SymbolExists(const char *name) {
     return GetRegisterOfTheSymbol(name) != -1 || GetOffsetOfTheSymbol(name) != (uint64_t)-1;
 }
 
-// allocate a reg for a new symbol
-int AllocateRegisterForTheSymbol(const char *name, bool is_string, const char *string_value) {
+// add a new variable symbol
+// no register is handed out here anymore: vars start memory-resident (reg 0)
+// and AllocateVariableRegisters (regalloc.c) assigns registers afterwards
+int AllocateRegisterForTheSymbol(const char *name, bool is_string) {
     // check if alr allocated
-    int existing = GetRegisterOfTheSymbol(name);
-    if(existing != -1) {
-        return existing;
+    int id = SymbolIndex(name);
+    if(id >= 0 && table[id].reg != -1) {
+        // a plain "ch x" decl looks like an int one, the first string store tells
+        // (only written once: codegen threads call this for known vars)
+        if(is_string && !table[id].is_string)
+            table[id].is_string = true;
+        return table[id].reg;
     }
     
-    // check limits
-    if(symbol_count >= MAX_SYMBOLS) {
-        return -1;
-    }
-    
-    // skip r1-r4 (r4 is for syscall args)
-    // skip forward to r5 if we're in the syscall range
-    if(next_reg >= 1 && next_reg <= 4)
-        next_reg = 5;
-
-    
-    if(next_reg > REG_MAX)
-        return -1;
+    GrowTable();
     
     // add symbol to table
     strncpy(table[symbol_count].name, name, MAX_NAME_LEN - 1);
     table[symbol_count].name[MAX_NAME_LEN - 1] = '\0';
-    table[symbol_count].reg = next_reg;
+    table[symbol_count].reg = 0;
     table[symbol_count].offset = next_offset;
+    table[symbol_count].size = 8;
+    table[symbol_count].slot = true;
     table[symbol_count].is_string = is_string;  // FIX 24
+    table[symbol_count].has_init = false;
+    table[symbol_count].init_value = 0;
+    IndexNewSymbol();
     
-    // FIX 24
-    if(is_string && string_value) {
-    table[symbol_count].string_value = strdup(string_value);
-    table[symbol_count].string_len = strlen(string_value) + 1; // +1 for null
-    // For strings, offset increments by actual string length
-    next_offset += table[symbol_count].string_len;
-    // Align to 8 bytes for next variable
-    if(next_offset % 8 != 0) {
-        next_offset += 8 - (next_offset % 8);
-    }
-    } else {
-        table[symbol_count].string_value = NULL;
-        table[symbol_count].string_len = 0;
-        // For non-strings, standard 8 bytes
-        next_offset += 8;
-    }
-
     symbol_count++;
-    next_offset += 8;  // 8 bytes/variable
+    next_offset += 8;  // 8 bytes/variable (FIX 24: ch vars too, the text stays in the literal pool)
     
-    return next_reg++;
+    return 0;
+}
+
+// bind a var to a register (0 = keep it in memory)
+void SetRegisterOfTheSymbol(const char *name, int reg) {
+    SetRegisterOfSymbolId(SymbolIndex(name), reg);
+}
+
+void SetRegisterOfSymbolId(int id, int reg) {
+    if(id >= 0 && id < symbol_count && table[id].reg != -1)
+        table[id].reg = reg;
+}
+
+// memory var whose first store is a compile-time constant: emitted as .dword
+void SetInitialValue(const char *name, int64_t value) {
+    SetInitialValueOfSymbolId(SymbolIndex(name), value);
+}
+
+void SetInitialValueOfSymbolId(int id, int64_t value) {
+    if(id >= 0 && id < symbol_count && table[id].reg != -1) {
+        table[id].has_init = true;
+        table[id].init_value = value;
+    }
+}
+
+// FIX 15: ch vars stay in memory (never get a register)
+bool IsStringSymbol(const char *name) {
+    return IsStringSymbolId(SymbolIndex(name));
+}
+
+bool IsStringSymbolId(int id) {
+    return id >= 0 && id < symbol_count && table[id].is_string;
 }
 
 // FIX: 1555555
@@ -137,37 +184,117 @@ int AllocateRegisterForTheSymbol(const char *name, bool is_string, const char *s
 // so GetOffsetOfTheSymbol("str0") returned -1 -> machine code generator failed
 // now we add them here w/ reg = -1 & proper offset
 // size includes null terminator (strlen(value) + 1)
-void AddLabel(const char *name, uint64_t size) {
+int AddLabel(const char *name, uint64_t size) {
     // check if alr exists (avoid duplicates)
-    for(int i = 0; i < symbol_count; i++) {
-        if(strcmp(table[i].name, name) == 0) {
-            return;
-        }
-    }
+    int existing = SymbolIndex(name);
+    if(existing >= 0)
+        return existing;
     
-    if(symbol_count >= MAX_SYMBOLS) {
-        return;
-    }
+    GrowTable();
     
     strncpy(table[symbol_count].name, name, MAX_NAME_LEN - 1);
     table[symbol_count].name[MAX_NAME_LEN - 1] = '\0';
     table[symbol_count].reg = -1;           // marks this as a label, not a variable
     table[symbol_count].offset = next_offset;
+    table[symbol_count].size = size;
+    table[symbol_count].slot = false;
+    table[symbol_count].is_string = false;
+    table[symbol_count].has_init = false;
+    table[symbol_count].init_value = 0;
+    IndexNewSymbol();
     
-    symbol_count++;
     next_offset += size;  // advance offset by string size (including '\0')
+    return symbol_count++;
+}
+
+// 8-byte label that is not a var (spill slot): laid out w/ the vars
+int AddDataSlot(const char *name) {
+    int id = AddLabel(name, 8);
+    table[id].slot = true;
+    return id;
+}
+
+// 8-byte slot holding a constant (.dword), for the constant pool
+int AddDataConstant(const char *name, int64_t value) {
+    int id = AddDataSlot(name);
+    table[id].has_init = true;
+    table[id].init_value = value;
+    return id;
+}
+
+static const uint64_t *slot_uses = NULL;
+
+// most used first, ties in registration order
+static int CompareSlotUse(const void *a, const void *b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    if(slot_uses[x] != slot_uses[y])
+        return slot_uses[x] > slot_uses[y] ? -1 : 1;
+    return x - y;
+}
+
+// final .data offsets: the 8-byte slots first, packed and ordered by use
+// count so the hot ones sit lowest (cheapest to reach), then the labels
+// in registration order, byte packed (runtime data sizes are multiples of
+// 8, strings need no alignment); returns the size of .data
+// a slot the code never touches (var that lives in a register) gets none
+uint64_t LayoutDataSection(const uint64_t *uses) {
+    free(slot_order);
+    slot_order = malloc(sizeof(int) * (symbol_count + 1));
+    slot_count = 0;
+    for(int i = 0; i < symbol_count; i++) {
+        if(table[i].slot && uses[i] > 0)
+            slot_order[slot_count++] = i;
+        else if(table[i].slot)
+            table[i].offset = (uint64_t)-1;
+    }
+    slot_uses = uses;
+    qsort(slot_order, slot_count, sizeof(int), CompareSlotUse);
+    slot_uses = NULL;
+
+    uint64_t offset = 0;
+    for(int k = 0; k < slot_count; k++) {
+        table[slot_order[k]].offset = offset;
+        offset += 8;
+    }
+    for(int i = 0; i < symbol_count; i++) {
+        if(!table[i].slot) {
+            table[i].offset = offset;
+            offset += table[i].size;
+        }
+    }
+    next_offset = offset;
+    return offset;
+}
+
+// symbol id (table index) used by the instruction IR, -1 if not found
+int SymbolIndex(const char *name) {
+    if(index_size == 0)
+        return -1;
+    return index_table[FindSlot(name)];
+}
+
+int SymbolCount() {
+    return symbol_count;
+}
+
+const char* GetSymbolName(int id) {
+    return (id >= 0 && id < symbol_count) ? table[id].name : "?";
+}
+
+uint64_t GetOffsetOfSymbolId(int id) {
+    return (id >= 0 && id < symbol_count) ? table[id].offset : (uint64_t)-1;
+}
+
+// -1 for labels and unknown ids, as GetRegisterOfTheSymbol
+int GetRegisterOfSymbolId(int id) {
+    return (id >= 0 && id < symbol_count) ? table[id].reg : -1;
 }
 
 // get memory offset for symbol
 // works for both variables & string labels (str0, str1, ...)
 // this is what the machine code generator uses to resolve "daddiu r4, r0, str0"
 uint64_t GetOffsetOfTheSymbol(const char *name) {
-    for(int i = 0; i < symbol_count; i++) {
-        if(strcmp(table[i].name, name) == 0) {
-            return table[i].offset;
-        }
-    }
-    return (uint64_t)-1; // not found
+    return GetOffsetOfSymbolId(SymbolIndex(name)); // -1 if not found
 }
 
 // print symbol table for debugging
@@ -177,11 +304,19 @@ void PrintAllSymbols(FILE *out) {
     fprintf(out, "; Symbol Table\n");
     fprintf(out, "; Name\tReg\tOffset\n");
     for(int i = 0; i < symbol_count; i++) {
-        if(table[i].reg != -1) {
+        if(table[i].reg > 0 && table[i].offset == (uint64_t)-1) {
+            fprintf(out, "; %s\tr%d\t-\n", table[i].name, table[i].reg); // no .data slot
+        } else if(table[i].reg == 0 && table[i].offset == (uint64_t)-1) {
+            fprintf(out, "; %s\tmem\t-\n", table[i].name); // never accessed
+        } else if(table[i].reg > 0) {
             fprintf(out, "; %s\tr%d\t0x%lX\n",
                     table[i].name,
                     table[i].reg,
                     (unsigned long)table[i].offset);
+        } else if(table[i].reg == 0) {
+            fprintf(out, "; %s\tmem\t0x%lX\n",
+                    table[i].name,
+                    (unsigned long)table[i].offset);
         }
     }
     fprintf(out, "\n");
@@ -5,20 +5,35 @@
 #include <stdbool.h> // FIX 15: daddiu w laels, store strs into the symbol table
 #include <stddef.h> // FIX 24
 
-#define MAX_SYMBOLS 100
+#define MAX_SYMBOLS 100 // initial table size (grows)
 #define MAX_NAME_LEN 50
-#define REG_MIN 1 // start from r1
-#define REG_MAX 19 // up to r19
 
 void PrintDataSection(FILE *out);
 void SymbolInit();
 int GetRegisterOfTheSymbol(const char *name);
 int SymbolExists(const char *name);
-int AllocateRegisterForTheSymbol(const char *name, bool is_string, const char *string_value); // FIX 15: added is_string
+int AllocateRegisterForTheSymbol(const char *name, bool is_string); // FIX 15: added is_string
+void SetRegisterOfTheSymbol(const char *name, int reg);
+void SetInitialValue(const char *name, int64_t value); // .dword instead of .space 8
 uint64_t GetOffsetOfTheSymbol(const char *name);
 void PrintAllSymbols(FILE *out);
-//bool IsStringSymbol(const char *name); // FIX 15
+bool IsStringSymbol(const char *name); // FIX 15
 
-void AddLabel(const char *name, uint64_t size);
+int AddLabel(const char *name, uint64_t size);
+int AddDataSlot(const char *name); // 8 bytes, placed w/ the vars
+int AddDataConstant(const char *name, int64_t value); // slot w/ a .dword value
+// final offsets (uses: per symbol id, how often the code references it)
+uint64_t LayoutDataSection(const uint64_t *uses);
+
+// lookups by symbol id (table index), used by the instruction IR and by
+// codegen through Node.sym; SymbolIndex is a hash lookup
+int SymbolIndex(const char *name);
+int SymbolCount();
+const char* GetSymbolName(int id);
+uint64_t GetOffsetOfSymbolId(int id);
+int GetRegisterOfSymbolId(int id);
+void SetRegisterOfSymbolId(int id, int reg);
+void SetInitialValueOfSymbolId(int id, int64_t value);
+bool IsStringSymbolId(int id);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,555 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include "x86_64.h"
+
+#define NODE_PRINT_PART 7
+#define NODE_STR_ASSIGN 8
+
+// fixed load addresses (non-PIE): every address fits a 32-bit immediate
+#define TEXT_VADDR 0x400000
+#define DATA_VADDR 0x40000000
+#define HEADERS_SIZE (sizeof(Elf64_Ehdr) + 2 * sizeof(Elf64_Phdr))
+
+// .bss: output buffer first, then one 4-byte slot per int var
+#define OUT_BUFFER DATA_VADDR
+#define OUT_BUFFER_SIZE 65536
+#define OUT_BUFFER_END (OUT_BUFFER + OUT_BUFFER_SIZE)
+#define VAR_BASE OUT_BUFFER_END
+
+// longest int: "-2147483648"
+#define INT_TEXT_MAX 12
+
+// a var as the interpreter would see it at this point of the program
+typedef struct {
+    char *name;
+    bool initialized;
+    bool is_string;
+    const char *text; // ch var: the literal it holds
+} X86Var;
+
+typedef struct {
+    uint8_t *bytes;
+    size_t count;
+    size_t capacity;
+} ByteBuffer;
+
+static ByteBuffer text; // code
+static ByteBuffer rodata; // print text
+static size_t *rodata_fixups = NULL; // code offsets of imm32s holding a rodata offset
+static int rodata_fixup_count = 0;
+static int rodata_fixup_capacity = 0;
+
+static X86Var *vars = NULL;
+static int var_count = 0;
+static int var_capacity = 0;
+
+// literal text waiting to be printed (merged across parts and statements)
+static char *pending = NULL;
+static size_t pending_len = 0;
+
+// code offsets of the runtime routines
+static size_t rt_div, rt_putint, rt_putstr, rt_flush;
+
+static void Append(ByteBuffer *buf, const void *data, size_t n) {
+    if(buf->count + n > buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        while(buf->capacity < buf->count + n)
+            buf->capacity *= 2;
+        buf->bytes = realloc(buf->bytes, buf->capacity);
+    }
+    memcpy(buf->bytes + buf->count, data, n);
+    buf->count += n;
+}
+
+static void Byte(uint8_t b) {
+    Append(&text, &b, 1);
+}
+
+// instruction bytes (opcode, modrm, ...), no immediates
+static void Bytes(int n, ...) {
+    va_list args;
+    va_start(args, n);
+    for(int i = 0; i < n; i++)
+        Byte((uint8_t)va_arg(args, int));
+    va_end(args);
+}
+
+static void Imm32(uint32_t v) {
+    uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+    Append(&text, b, 4);
+}
+
+static void Patch32(size_t at, uint32_t v) {
+    for(int i = 0; i < 4; i++)
+        text.bytes[at + i] = v >> (8 * i);
+}
+
+// jcc/jmp rel8 to a label bound later: returns where the offset goes
+static size_t Jump8(uint8_t opcode) {
+    Bytes(2, opcode, 0);
+    return text.count - 1;
+}
+
+static void Bind8(size_t at) {
+    text.bytes[at] = (uint8_t)(text.count - (at + 1));
+}
+
+static void JumpBack8(uint8_t opcode, size_t target) {
+    Bytes(2, opcode, (uint8_t)(target - (text.count + 2)));
+}
+
+// call/jmp rel32 to a routine alr emitted
+static void Rel32(uint8_t opcode, size_t target) {
+    Byte(opcode);
+    Imm32((uint32_t)(target - (text.count + 4)));
+}
+
+static void Call(size_t target) {
+    Rel32(0xE8, target);
+}
+
+// op reg, [abs32]: modrm w/ a SIB that has no base and no index
+static void Absolute(int reg, uint32_t address) {
+    Bytes(2, (reg << 3) | 0x04, 0x25);
+    Imm32(address);
+}
+
+// the runtime: output buffer cursor lives in r15 for the whole program
+static void EmitRuntime() {
+    // _div: eax = eax / ecx; x / 0 = 0, INT_MIN / -1 wraps (no #DE)
+    rt_div = text.count;
+    Bytes(2, 0x85, 0xC9);                    // test ecx, ecx
+    size_t zero = Jump8(0x74);               // je .zero
+    Bytes(3, 0x83, 0xF9, 0xFF);              // cmp ecx, -1
+    size_t negate = Jump8(0x74);             // je .neg
+    Bytes(4, 0x99, 0xF7, 0xF9, 0xC3);        // cdq; idiv ecx; ret
+    Bind8(zero);
+    Bytes(3, 0x31, 0xC0, 0xC3);              // xor eax, eax; ret
+    Bind8(negate);
+    Bytes(3, 0xF7, 0xD8, 0xC3);              // neg eax; ret
+
+    // _write: write(1, rsi, rdx) until all of it is out (or an error)
+    size_t rt_write = text.count;
+    Bytes(3, 0x48, 0x85, 0xD2);              // test rdx, rdx
+    size_t done = Jump8(0x74);               // je .done
+    Byte(0xBF); Imm32(1);                    // mov edi, 1
+    Byte(0xB8); Imm32(1);                    // mov eax, 1 (write)
+    Bytes(2, 0x0F, 0x05);                    // syscall
+    Bytes(3, 0x48, 0x85, 0xC0);              // test rax, rax
+    size_t failed = Jump8(0x7E);             // jle .done
+    Bytes(6, 0x48, 0x01, 0xC6, 0x48, 0x29, 0xC2); // add rsi, rax; sub rdx, rax
+    JumpBack8(0xEB, rt_write);               // jmp _write
+    Bind8(done);
+    Bind8(failed);
+    Byte(0xC3);                              // ret
+
+    // _flush: write out the buffer, cursor back to its start
+    rt_flush = text.count;
+    Byte(0xBE); Imm32(OUT_BUFFER);           // mov esi, buffer
+    Bytes(3, 0x4C, 0x89, 0xFA);              // mov rdx, r15
+    Bytes(3, 0x48, 0x29, 0xF2);              // sub rdx, rsi
+    Bytes(3, 0x49, 0x89, 0xF7);              // mov r15, rsi
+    JumpBack8(0xEB, rt_write);               // jmp _write
+
+    // _putstr: rcx bytes at rsi into the buffer (too big: written directly)
+    rt_putstr = text.count;
+    Byte(0xB8); Imm32(OUT_BUFFER_END);       // mov eax, buffer end
+    Bytes(3, 0x4C, 0x29, 0xF8);              // sub rax, r15
+    Bytes(3, 0x48, 0x39, 0xC1);              // cmp rcx, rax
+    size_t fits = Jump8(0x76);               // jbe .copy
+    Bytes(2, 0x56, 0x51);                    // push rsi; push rcx
+    Call(rt_flush);
+    Bytes(2, 0x59, 0x5E);                    // pop rcx; pop rsi
+    Bytes(3, 0x48, 0x81, 0xF9); Imm32(OUT_BUFFER_SIZE); // cmp rcx, size
+    size_t fits_empty = Jump8(0x76);         // jbe .copy
+    Bytes(3, 0x48, 0x89, 0xCA);              // mov rdx, rcx
+    Rel32(0xE9, rt_write);                   // jmp _write
+    Bind8(fits);
+    Bind8(fits_empty);
+    Bytes(3, 0x4C, 0x89, 0xFF);              // mov rdi, r15
+    Bytes(2, 0xF3, 0xA4);                    // rep movsb
+    Bytes(4, 0x49, 0x89, 0xFF, 0xC3);        // mov r15, rdi; ret
+
+    // _putint: eax as decimal into the buffer (digits built below rsp)
+    rt_putint = text.count;
+    Byte(0xB9); Imm32(OUT_BUFFER_END - INT_TEXT_MAX); // mov ecx, last safe cursor
+    Bytes(3, 0x49, 0x39, 0xCF);              // cmp r15, rcx
+    size_t room = Jump8(0x76);               // jbe .room
+    Byte(0x50);                              // push rax
+    Call(rt_flush);
+    Byte(0x58);                              // pop rax
+    Bind8(room);
+    Bytes(2, 0x85, 0xC0);                    // test eax, eax
+    size_t positive = Jump8(0x79);           // jns .pos
+    Bytes(4, 0x41, 0xC6, 0x07, '-');         // mov byte [r15], '-'
+    Bytes(3, 0x49, 0xFF, 0xC7);              // inc r15
+    Bytes(2, 0xF7, 0xD8);                    // neg eax (INT_MIN: 2^31 unsigned)
+    Bind8(positive);
+    Bytes(3, 0x48, 0x89, 0xE6);              // mov rsi, rsp
+    Byte(0xB9); Imm32(10);                   // mov ecx, 10
+    size_t digit = text.count;
+    Bytes(4, 0x31, 0xD2, 0xF7, 0xF1);        // xor edx, edx; div ecx
+    Bytes(3, 0x80, 0xC2, '0');               // add dl, '0'
+    Bytes(5, 0x48, 0xFF, 0xCE, 0x88, 0x16);  // dec rsi; mov [rsi], dl
+    Bytes(2, 0x85, 0xC0);                    // test eax, eax
+    JumpBack8(0x75, digit);                  // jne .digit
+    size_t copy = text.count;
+    Bytes(5, 0x8A, 0x06, 0x41, 0x88, 0x07);  // mov al, [rsi]; mov [r15], al
+    Bytes(6, 0x48, 0xFF, 0xC6, 0x49, 0xFF, 0xC7); // inc rsi; inc r15
+    Bytes(3, 0x48, 0x39, 0xE6);              // cmp rsi, rsp
+    JumpBack8(0x75, copy);                   // jne .copy
+    Byte(0xC3);                              // ret
+}
+
+static X86Var* FindVar(const char *name) {
+    for(int i = 0; i < var_count; i++) {
+        if(strcmp(vars[i].name, name) == 0)
+            return &vars[i];
+    }
+    return NULL;
+}
+
+static X86Var* GetVar(const char *name) {
+    X86Var *var = FindVar(name);
+    if(var)
+        return var;
+    if(var_count >= var_capacity) {
+        var_capacity = var_capacity ? var_capacity * 2 : 64;
+        vars = realloc(vars, sizeof(X86Var) * var_capacity);
+    }
+    var = &vars[var_count++];
+    var->name = strdup(name);
+    var->initialized = false;
+    var->is_string = false;
+    var->text = NULL;
+    return var;
+}
+
+static uint32_t VarAddress(const X86Var *var) {
+    return VAR_BASE + 4 * (uint32_t)(var - vars);
+}
+
+// holds an int value at run time (else it reads as 0)
+static bool IsIntVar(const X86Var *var) {
+    return var && var->initialized && !var->is_string;
+}
+
+// 32-bit wrapping arithmetic, as the interpreter's int
+static int32_t FoldOp(int op, int32_t left, int32_t right) {
+    switch(op) {
+        case '+': return (int32_t)((uint32_t)left + (uint32_t)right);
+        case '-': return (int32_t)((uint32_t)left - (uint32_t)right);
+        case '*': return (int32_t)((uint32_t)left * (uint32_t)right);
+        case '/':
+            if(right == 0)
+                return 0;
+            if(right == -1)
+                return (int32_t)(0u - (uint32_t)left);
+            return left / right;
+        case '=': return left;
+    }
+    return 0;
+}
+
+// value known at compile time (unset and ch vars read as 0)
+static bool Fold(Node *node, int32_t *value) {
+    if(!node) {
+        *value = 0;
+        return true;
+    }
+    switch(node->node_type) {
+        case 0: // NODE_NUM
+            *value = node->int_val;
+            return true;
+        case 2: // NODE_ID
+            *value = 0;
+            return !IsIntVar(FindVar(node->str_val));
+        case 3: { // NODE_BINOP
+            int32_t left, right;
+            if(!Fold(node->binop.left, &left) || !Fold(node->binop.right, &right))
+                return false;
+            *value = FoldOp(node->binop.op, left, right);
+            return true;
+        }
+    }
+    *value = 0;
+    return true;
+}
+
+static void LoadConstant(int32_t k) {
+    if(k == 0)
+        Bytes(2, 0x31, 0xC0);                // xor eax, eax
+    else {
+        Byte(0xB8);                          // mov eax, k
+        Imm32((uint32_t)k);
+    }
+}
+
+// constant or int var: usable as the right operand of an instruction
+static bool IsOperand(Node *node) {
+    int32_t k;
+    return Fold(node, &k) || node->node_type == 2;
+}
+
+// eax = eax op operand
+static void ApplyOperand(int op, Node *operand) {
+    int32_t k;
+    if(Fold(operand, &k)) {
+        switch(op) {
+            case '+': if(k) { Byte(0x05); Imm32(k); } break;             // add eax, k
+            case '-': if(k) { Byte(0x2D); Imm32(k); } break;             // sub eax, k
+            case '*': Bytes(2, 0x69, 0xC0); Imm32(k); break;             // imul eax, eax, k
+            case '/': Byte(0xB9); Imm32(k); Call(rt_div); break;        // mov ecx, k
+        }
+        return;
+    }
+    uint32_t address = VarAddress(FindVar(operand->str_val));
+    switch(op) {
+        case '+': Byte(0x03); Absolute(0, address); break;              // add eax, [x]
+        case '-': Byte(0x2B); Absolute(0, address); break;              // sub eax, [x]
+        case '*': Bytes(2, 0x0F, 0xAF); Absolute(0, address); break;    // imul eax, [x]
+        case '/': Byte(0x8B); Absolute(1, address); Call(rt_div); break; // mov ecx, [x]
+    }
+}
+
+// expression value into eax (clobbers ecx, edx; uses the stack)
+static void GenerateExpression(Node *node) {
+    int32_t k;
+    if(Fold(node, &k)) {
+        LoadConstant(k);
+        return;
+    }
+    if(node->node_type == 2) { // NODE_ID
+        Byte(0x8B);                          // mov eax, [x]
+        Absolute(0, VarAddress(FindVar(node->str_val)));
+        return;
+    }
+
+    // NODE_BINOP that doesn't fold
+    int op = node->binop.op;
+    Node *left = node->binop.left;
+    Node *right = node->binop.right;
+    if(op == '=') {
+        GenerateExpression(left);
+    } else if(op != '+' && op != '-' && op != '*' && op != '/') {
+        LoadConstant(0);
+    } else if(IsOperand(right)) {
+        GenerateExpression(left);
+        ApplyOperand(op, right);
+    } else if((op == '+' || op == '*') && IsOperand(left)) {
+        GenerateExpression(right);
+        ApplyOperand(op, left);
+    } else {
+        GenerateExpression(right);
+        Byte(0x50);                          // push rax
+        GenerateExpression(left);
+        Byte(0x59);                          // pop rcx
+        switch(op) {
+            case '+': Bytes(2, 0x01, 0xC8); break;       // add eax, ecx
+            case '-': Bytes(2, 0x29, 0xC8); break;       // sub eax, ecx
+            case '*': Bytes(3, 0x0F, 0xAF, 0xC1); break; // imul eax, ecx
+            case '/': Call(rt_div); break;
+        }
+    }
+}
+
+static void AppendPending(const char *s, size_t len) {
+    pending = realloc(pending, pending_len + len + 1);
+    memcpy(pending + pending_len, s, len);
+    pending_len += len;
+    pending[pending_len] = '\0';
+}
+
+// literal text gathered so far goes out w/ one _putstr
+static void FlushPending() {
+    if(pending_len == 0)
+        return;
+    if(rodata_fixup_count >= rodata_fixup_capacity) {
+        rodata_fixup_capacity = rodata_fixup_capacity ? rodata_fixup_capacity * 2 : 64;
+        rodata_fixups = realloc(rodata_fixups, sizeof(size_t) * rodata_fixup_capacity);
+    }
+    Byte(0xBE);                              // mov esi, text (patched)
+    rodata_fixups[rodata_fixup_count++] = text.count;
+    Imm32((uint32_t)rodata.count);
+    Append(&rodata, pending, pending_len);
+    Byte(0xB9);                              // mov ecx, len
+    Imm32((uint32_t)pending_len);
+    Call(rt_putstr);
+    pending_len = 0;
+}
+
+static void PendingInt(int32_t value) {
+    char digits[INT_TEXT_MAX];
+    AppendPending(digits, sprintf(digits, "%d", value));
+}
+
+// x = expr / x = "text" / x (decl w/o a value), as execute_statement does them
+static void GenerateStore(Node *item, bool in_declaration) {
+    if(item->node_type == 3 && item->binop.op == '=') {
+        GenerateExpression(item->binop.right);
+        X86Var *var = GetVar(item->binop.left->str_val);
+        Byte(0x89);                          // mov [x], eax
+        Absolute(0, VarAddress(var));
+        var->initialized = true;
+        var->is_string = false;
+    } else if(item->node_type == NODE_STR_ASSIGN) {
+        X86Var *var = GetVar(item->str_assign.id->str_val);
+        var->text = item->str_assign.str->str_val;
+        var->initialized = true;
+        var->is_string = true;
+    } else if(item->node_type == 2 && in_declaration) {
+        // reads as 0 again (still a ch var if it was one)
+        GetVar(item->str_val)->initialized = false;
+    }
+}
+
+static void GeneratePrint(Node *node) {
+    Node *last_part = NULL;
+    for(Node *part = node->print_stmt.parts; part; part = part->list.next) {
+        last_part = part;
+        if(part->node_type != NODE_PRINT_PART)
+            continue;
+        Node *content = part->list.items;
+        int32_t k;
+        if(content->node_type == 1) { // NODE_STR
+            AppendPending(content->str_val, strlen(content->str_val));
+        } else if(content->node_type == 2) { // NODE_ID
+            X86Var *var = FindVar(content->str_val);
+            if(var && var->initialized && var->is_string) {
+                AppendPending(var->text, strlen(var->text));
+            } else if(IsIntVar(var)) {
+                FlushPending();
+                GenerateExpression(content);
+                Call(rt_putint);
+            } else {
+                AppendPending("0", 1);
+            }
+        } else if(Fold(content, &k)) {
+            PendingInt(k);
+        } else {
+            FlushPending();
+            GenerateExpression(content);
+            Call(rt_putint);
+        }
+    }
+
+    // FIX 16: \n unless the line ends w/ a string literal or a ch var
+    if(last_part && last_part->node_type == NODE_PRINT_PART) {
+        Node *last = last_part->list.items;
+        if(last->node_type == 2) {
+            X86Var *var = FindVar(last->str_val);
+            if(!var || !var->is_string)
+                AppendPending("\n", 1);
+        } else if(last->node_type != 1) {
+            AppendPending("\n", 1);
+        }
+    }
+}
+
+static void GenerateStatement(Node *node) {
+    switch(node->node_type) {
+        case 4: // NODE_DECL
+        case 5: // NODE_ASSIGN
+            for(Node *item = node->list.items; item; item = item->list.next)
+                GenerateStore(item, node->node_type == 4);
+            break;
+        case 6: // NODE_PRINT
+            GeneratePrint(node);
+            break;
+    }
+}
+
+static bool WriteExecutable(const char *filename, size_t entry) {
+    FILE *f = fopen(filename, "wb");
+    if(!f)
+        return false;
+
+    uint64_t text_size = HEADERS_SIZE + text.count + rodata.count;
+    Elf64_Ehdr eh = { 0 };
+    memcpy(eh.e_ident, ELFMAG, SELFMAG);
+    eh.e_ident[EI_CLASS] = ELFCLASS64;
+    eh.e_ident[EI_DATA] = ELFDATA2LSB;
+    eh.e_ident[EI_VERSION] = EV_CURRENT;
+    eh.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    eh.e_type = ET_EXEC;
+    eh.e_machine = EM_X86_64;
+    eh.e_version = EV_CURRENT;
+    eh.e_entry = TEXT_VADDR + HEADERS_SIZE + entry;
+    eh.e_phoff = sizeof(Elf64_Ehdr);
+    eh.e_ehsize = sizeof(Elf64_Ehdr);
+    eh.e_phentsize = sizeof(Elf64_Phdr);
+    eh.e_phnum = 2;
+
+    // headers, code and print text in one r-x segment; vars and the
+    // buffer are all .bss (nothing in the file)
+    Elf64_Phdr ph[2] = { { 0 } };
+    ph[0].p_type = PT_LOAD;
+    ph[0].p_flags = PF_R | PF_X;
+    ph[0].p_vaddr = ph[0].p_paddr = TEXT_VADDR;
+    ph[0].p_filesz = ph[0].p_memsz = text_size;
+    ph[0].p_align = 0x1000;
+    ph[1].p_type = PT_LOAD;
+    ph[1].p_flags = PF_R | PF_W;
+    ph[1].p_vaddr = ph[1].p_paddr = DATA_VADDR;
+    ph[1].p_memsz = OUT_BUFFER_SIZE + 4 * (uint64_t)var_count;
+    ph[1].p_align = 0x1000;
+
+    fwrite(&eh, sizeof(eh), 1, f);
+    fwrite(ph, sizeof(ph), 1, f);
+    fwrite(text.bytes, 1, text.count, f);
+    fwrite(rodata.bytes, 1, rodata.count, f);
+    bool ok = ferror(f) == 0;
+    ok = fclose(f) == 0 && ok;
+    chmod(filename, 0755);
+    return ok;
+}
+
+static void X86Free() {
+    free(text.bytes);
+    free(rodata.bytes);
+    text = (ByteBuffer){ 0 };
+    rodata = (ByteBuffer){ 0 };
+    free(rodata_fixups);
+    rodata_fixups = NULL;
+    rodata_fixup_count = rodata_fixup_capacity = 0;
+    for(int i = 0; i < var_count; i++)
+        free(vars[i].name);
+    free(vars);
+    vars = NULL;
+    var_count = var_capacity = 0;
+    free(pending);
+    pending = NULL;
+    pending_len = 0;
+}
+
+bool GenerateX86Executable(Node *program, const char *filename) {
+    X86Free();
+    EmitRuntime();
+
+    size_t entry = text.count;
+    Bytes(3, 0x49, 0xC7, 0xC7); Imm32(OUT_BUFFER); // mov r15, buffer
+    for(Node *stmt = program; stmt; stmt = stmt->list.next)
+        GenerateStatement(stmt);
+    FlushPending();
+    Call(rt_flush);
+    Byte(0xB8); Imm32(60);                   // mov eax, 60 (exit)
+    Bytes(4, 0x31, 0xFF, 0x0F, 0x05);        // xor edi, edi; syscall
+
+    // print text sits right after the code
+    uint32_t rodata_vaddr = TEXT_VADDR + HEADERS_SIZE + text.count;
+    for(int i = 0; i < rodata_fixup_count; i++) {
+        size_t at = rodata_fixups[i];
+        uint32_t offset = text.bytes[at] | text.bytes[at + 1] << 8 | text.bytes[at + 2] << 16 | (uint32_t)text.bytes[at + 3] << 24;
+        Patch32(at, rodata_vaddr + offset);
+    }
+
+    bool ok = WriteExecutable(filename, entry);
+    X86Free();
+    return ok;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef X86_64_H
+#define X86_64_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+// --target=x86_64: lowers the AST straight to x86-64 machine code and
+// writes a static ELF64 executable (no assembler, no libc)
+//   ints are 32-bit and wrap, x / 0 is 0 (same as interpreter.c)
+//   prints go through an output buffer, flushed w/ the write syscall
+// statements are straight-line, so which vars are set / hold a string is
+// tracked at compile time; only int values live in memory at run time
+// false if the file can't be written
+bool GenerateX86Executable(Node *program, const char *filename);
+
+#endif
\ No newline at end of file